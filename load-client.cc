@@ -0,0 +1,97 @@
+// Sends requests read from stdin, one JSON object per line, to a solver server
+// over several connections at once, then reports the throughput and the
+// latency of the requests.
+//   ./load-client SOCKET [CONNECTIONS] < REQUESTS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+double Now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int Connect(const char* path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connection < 0 || connect(connection, (sockaddr*)&address, sizeof(address)) != 0) {
+    fprintf(stderr, "Can't connect to '%s'.\n", path);
+    exit(-1);
+  }
+  return connection;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s SOCKET [CONNECTIONS] < REQUESTS\n", argv[0]);
+    exit(-1);
+  }
+  const char* path = argv[1];
+  int num_connections = argc > 2 ? std::max(1, atoi(argv[2])) : 1;
+
+  std::vector<std::string> requests;
+  char* line = nullptr;
+  size_t size = 0;
+  while (getline(&line, &size, stdin) > 0)
+    if (strspn(line, " \t\r\n") < strlen(line)) requests.push_back(line);
+  free(line);
+
+  std::vector<double> latencies(requests.size());
+  std::atomic<size_t> next_request{0};
+  std::atomic<int> num_errors{0};
+  auto start_time = Now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_connections; ++i)
+    threads.emplace_back([&] {
+      int connection = Connect(path);
+      FILE* in = fdopen(connection, "r");
+      FILE* out = fdopen(dup(connection), "w");
+      char* line = nullptr;
+      size_t size = 0;
+      for (size_t r; (r = next_request++) < requests.size();) {
+        auto request_time = Now();
+        fputs(requests[r].c_str(), out);
+        fflush(out);
+        // Results are streamed until the one that is done.
+        bool done = false;
+        while (!done && getline(&line, &size, in) > 0) {
+          if (strstr(line, "\"error\"")) ++num_errors;
+          done = strstr(line, "\"done\": true") != nullptr;
+        }
+        if (!done) {
+          fprintf(stderr, "Connection closed during request %zu.\n", r + 1);
+          exit(-1);
+        }
+        latencies[r] = Now() - request_time;
+      }
+      free(line);
+      fclose(in);
+      fclose(out);
+    });
+  for (auto& thread : threads) thread.join();
+  auto elapsed = Now() - start_time;
+
+  if (requests.empty()) return 0;
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies[std::min(latencies.size() - 1, size_t(p / 100 * latencies.size()))];
+  };
+  printf("%zu requests, %d errors, %.2f s, %.1f requests/s\n", requests.size(),
+         num_errors.load(), elapsed, requests.size() / elapsed);
+  printf("latency  p50 %.3f s  p90 %.3f s  p99 %.3f s  max %.3f s\n", percentile(50),
+         percentile(90), percentile(99), latencies.back());
+  return 0;
+}
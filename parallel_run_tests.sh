@@ -4,6 +4,10 @@ if [[ $1 == '-r' ]]; then
   echo $3 $(./solver -if $2/$3 -m0 | sed -e "s/[0-9]*\.[0-9]* [sM]//g")
   exit
 fi
+if [[ $1 == '-e' ]]; then
+  echo $(./solver -if $2/$3 -m0 -e) $3
+  exit
+fi
 
 test_dir=${1:-fixed_deals}
 test_dir=${test_dir%%/*}  # remove trailing slashes
@@ -13,7 +17,10 @@ echo Results are in $results
 cat $test_dir/* > /dev/null  # bring files into cache
 
 start=$(date +"%s.%N")
+# Start the deals estimated to take longest first.
 ls $test_dir -I RESULTS | \
+  xargs -L 1 -P $parallelism ./parallel_run_tests.sh -e $test_dir | \
+  sort -rn | cut -d' ' -f3 | \
   xargs -L 1 -P $parallelism ./parallel_run_tests.sh -r $test_dir > $results
 finish=$(date +"%s.%N")
 
@@ -1,25 +1,41 @@
 #include <assert.h>
 #include <ctype.h>
+#include <fcntl.h>
 #if defined(__BMI2__) || defined(__SSE4_1__)
 #include <immintrin.h>
 #endif
+#ifdef _PROFILE
+#include <x86intrin.h>
+#endif
 #include <inttypes.h>
 #include <limits.h>
+#include <math.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <map>
 #include <memory>
-#include <random>
+#include <mutex>
 #include <set>
+#include <string>
+#include <thread>
 #include <vector>
 
 // clang-format off
@@ -32,6 +48,11 @@
 #define VERBOSE(statement)
 #define STATS(statement)
 #endif
+#ifdef _PROFILE
+#define PROFILE(phase) Profiler::Scope profile_##phase(Profiler::phase, depth)
+#else
+#define PROFILE(phase)
+#endif
 // clang-format on
 
 enum { SPADE, HEART, DIAMOND, CLUB, NUM_SUITS, NOTRUMP = NUM_SUITS };
@@ -121,37 +142,75 @@ struct CardInitializer {
 
 struct Options {
   char* code = nullptr;
+  char* endgame_file = nullptr;
   char* input_file = nullptr;
+  char* par = nullptr;
+  char* play_record = nullptr;
+  char* results_file = nullptr;
   char* shuffle_seats = nullptr;
+  char* socket_path = nullptr;
+  std::vector<char*> constraints;
   int trump = -1;
   int guess_tricks = -1;
   int displaying_depth = -1;
+  int num_threads = 1;
+  int num_workers = 1;
+  int max_samples = 0;
+  int num_deals = 0;
   int stats_level = 0;
   int show_hands_mask = 2;
+  int trick_cache_tricks = 0;
+  double cell_time_limit = 0;
+  double deal_time_limit = 0;
+  long long cell_node_limit = 0;
+  long long progress_nodes = 0;
+  uint64_t seed = 0;
+  uint64_t stream = 0;
+  bool seeded = false;
   bool deal_only = false;
   bool discard_suit_bottom = false;
   bool randomize = false;
   bool ignore_trump_and_lead = false;
   bool play_interactively = false;
+  bool huge_pages = false;
+  bool estimate_cost = false;
 
   void Read(int argc, char* argv[]) {
     int c;
-    while ((c = getopt(argc, argv, "c:df:im:oprs:t:D:G:S:")) != -1) {
+    while ((c = getopt(argc, argv, "a:c:def:g:ij:m:oprs:t:u:v:w:x:y:B:D:G:HK:L:M:N:P:R:S:T:")) != -1) {
       switch (c) {
         // clang-format off
+        case 'a': play_record = optarg; break;
         case 'c': code = optarg; break;
         case 'd': discard_suit_bottom = true; break;
+        case 'e': estimate_cost = true; break;
         case 'f': input_file = optarg; break;
+        case 'g': num_deals = atoi(optarg); break;
         case 'i': ignore_trump_and_lead = true; break;
+        case 'j': num_threads = std::max(1, atoi(optarg)); break;
         case 'm': show_hands_mask = atoi(optarg); break;
         case 'o': deal_only = true; break;
         case 'p': play_interactively = true; break;
         case 'r': randomize = true; break;
         case 's': shuffle_seats = optarg; break;
         case 't': trump = CharToSuit(optarg[0]); break;
+        case 'u': socket_path = optarg; break;
+        case 'v': progress_nodes = atoll(optarg); break;
+        case 'w': num_workers = std::max(1, atoi(optarg)); break;
+        case 'x': seeded = sscanf(optarg, "%" SCNu64 ":%" SCNu64, &seed, &stream) >= 1; break;
+        case 'y': max_samples = atoi(optarg); break;
+        case 'B': endgame_file = optarg; break;
         case 'D': displaying_depth = atoi(optarg); break;
         case 'G': guess_tricks = atoi(optarg); break;
+        case 'H': huge_pages = true; break;
+        case 'K': constraints.push_back(optarg); break;
+        case 'L': deal_time_limit = atof(optarg); break;
+        case 'M': trick_cache_tricks = atoi(optarg); break;
+        case 'N': cell_node_limit = atoll(optarg); break;
+        case 'P': par = optarg; break;
+        case 'R': results_file = optarg; break;
         case 'S': stats_level = atoi(optarg); break;
+        case 'T': cell_time_limit = atof(optarg); break;
           // clang-format on
       }
     }
@@ -163,16 +222,41 @@ struct Options {
            "\t-f <file>    Solve a deal in the input file. See files in *_deals/ for examples.\n"
            "\t-c <code>    Solve a deal defined by its unique code. See -m below.\n"
            "\t-p           Play interactively, possibly exploring all paths.\n"
+           "\t-a <plays>   Analyze a play record like 'CJCAC6C2' or 'pc|CJ|pc|CA|'.\n"
+           "\t             The trump and the lead must be given, e.g. in the input file.\n"
+           "\t-y <layouts> Recommend the next card single-dummy from up to this many layouts\n"
+           "\t             of the hidden hands, after the plays given by -a if any.\n"
+           "\t-u <path>    Serve JSON requests on a Unix socket, or on stdin and stdout if '-'.\n"
+           "\t-w <workers> Fork this many server processes to take connections.\n"
+           "\t-g <deals>   Generate this many deals filling the hands of -r or -f, and solve\n"
+           "\t             each unless -o is given.\n"
+           "\t-K <limits>  Limit the points and suit lengths of a seat in generated deals,\n"
+           "\t             like 'N:P15-17,S5+,H0-4'. Can be repeated.\n"
+           "\t-x <seed>[:<stream>]  Seed the random deals, one stream per parallel run.\n"
            "\n"
            "\t-s <seats>   Shuffle hands in the specified seats, a combination of {W, N, E, S}.\n"
            "\t-m <mask>    Mask for showing a deal. The following values can be added.\n"
            "\t               1    Show the deal's unique code\n"
            "\t               2    Show the deal in compact format\n"
            "\t               4    Show the deal in expanded format\n"
+           "\t               8    Show the code of the deal's canonical form\n"
            "\t-o           Show the deal without solving it.\n"
+           "\t-e           Estimate the seconds to solve all strains and leads of the deal.\n"
            "\t-i           Ignore the trump and the lead specified in the input file.\n"
            "\t-t <trump>   Solve for the specified trump, one of {N, S, H, D, C}.\n"
-           "\t-d           Discard only the smallest card in a suit, imprecise but faster.\n");
+           "\t-P <dealer>[/<vul>]  Find the par score and contracts, probing only the\n"
+           "\t             tricks they depend on. Vulnerability is None, NS, EW or All.\n"
+           "\t-d           Discard only the smallest card in a suit, imprecise but faster.\n"
+           "\t-j <threads> Run up to this many null-window probes in parallel.\n"
+           "\t-T <seconds> Stop solving a strain and lead after this long, keeping proven bounds.\n"
+           "\t-L <seconds> Stop solving the deal after this long, keeping proven bounds.\n"
+           "\t-N <nodes>   Stop solving a strain and lead after this many nodes.\n"
+           "\t-v <nodes>   Report the progress to stderr every this many nodes.\n"
+           "\t-H           Back the caches with 2 MB pages where the system allows.\n"
+           "\t-M <tricks>  Also cache bounds within tricks with at least this many tricks left.\n"
+           "\t             Saves nodes but takes longer.\n"
+           "\t-R <file>    Look up and record results in a store shared by equivalent deals.\n"
+           "\t-B <file>    Look up the last tricks in an endgame table, building it if missing.\n");
     exit(0);
   }
 } options;
@@ -183,6 +267,109 @@ double Now() {
   return now.tv_sec + now.tv_usec * 1e-6;
 }
 
+// SplitMix64, which is fast and seeds independent streams by mixing the
+// stream into the seed.
+class Random {
+ public:
+  typedef uint64_t result_type;
+
+  Random(uint64_t seed, uint64_t stream = 0) : state(Mix(seed ^ Mix(stream + 1))) {}
+
+  static constexpr uint64_t min() { return 0; }
+  static constexpr uint64_t max() { return UINT64_MAX; }
+  uint64_t operator()() { return Mix(state += 0x9e3779b97f4a7c15ULL); }
+
+  // A number below n, by multiplication instead of division.
+  int Below(int n) { return ((*this)() >> 32) * n >> 32; }
+
+ private:
+  static uint64_t Mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t state;
+};
+
+// Seeded once from -x, or from the time and the process id so that runs in
+// parallel get different deals.
+Random& SharedRandom() {
+  static Random random = options.seeded
+                             ? Random(options.seed, options.stream)
+                             : Random(uint64_t(Now() * 1e6), getpid());
+  return random;
+}
+
+#ifdef _PROFILE
+// Cycles spent in each phase of the search by depth, not counting the
+// phases nested in it. Only the thread calling Solve() is counted.
+class Profiler {
+ public:
+  enum Phase { SEARCH, SHAPE, LOOKUP, STATIC, ORDER, UPDATE, NUM_PHASES, IDLE = NUM_PHASES };
+
+ private:
+  struct Slot {
+    Phase phase;
+    int depth;
+  };
+
+ public:
+  class Scope {
+   public:
+    Scope(Phase phase, int depth) : outer(current) {
+      Switch();
+      current = {phase, depth};
+      ++calls[depth][phase];
+    }
+    ~Scope() {
+      Switch();
+      current = outer;
+    }
+
+   private:
+    const Slot outer;
+  };
+
+  static void Show() {
+    static const char* names[] = {"search", "shape", "lookup", "static", "order", "update"};
+    uint64_t total[NUM_PHASES] = {}, all = 0;
+    for (int depth = 0; depth < TOTAL_CARDS; ++depth)
+      for (int phase = 0; phase < NUM_PHASES; ++phase) total[phase] += cycles[depth][phase];
+    for (int phase = 0; phase < NUM_PHASES; ++phase) all += total[phase];
+    printf("--- Profile (M cycles) ---\ndepth");
+    for (int phase = 0; phase < NUM_PHASES; ++phase) printf(" %9s", names[phase]);
+    printf(" %11s\n", "calls");
+    for (int depth = 0; depth < TOTAL_CARDS; ++depth) {
+      if (!calls[depth][SEARCH]) continue;
+      printf("%5d", depth);
+      for (int phase = 0; phase < NUM_PHASES; ++phase) printf(" %9.1f", cycles[depth][phase] / 1e6);
+      printf(" %11" PRIu64 "\n", calls[depth][SEARCH]);
+    }
+    printf("total");
+    for (int phase = 0; phase < NUM_PHASES; ++phase) printf(" %9.1f", total[phase] / 1e6);
+    printf("\n    %%");
+    for (int phase = 0; phase < NUM_PHASES; ++phase)
+      printf(" %9.1f", all ? 100.0 * total[phase] / all : 0);
+    puts("");
+    memset(cycles, 0, sizeof(cycles));
+    memset(calls, 0, sizeof(calls));
+  }
+
+ private:
+  static void Switch() {
+    uint64_t now = __rdtsc();
+    cycles[current.depth][current.phase] += now - last;
+    last = now;
+  }
+
+  static inline thread_local Slot current = {IDLE, 0};
+  static inline thread_local uint64_t last = 0;
+  static inline thread_local uint64_t cycles[TOTAL_CARDS][NUM_PHASES + 1];
+  static inline thread_local uint64_t calls[TOTAL_CARDS][NUM_PHASES];
+};
+#endif
+
 template <class T>
 int BitSize(T v) {
   return sizeof(v) * 8;
@@ -215,6 +402,38 @@ uint64_t UnpackBits(uint64_t source, uint64_t mask) {
 #endif
 }
 
+constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// Maps zeroed memory for a large table and rounds `bytes` up to the mapped
+// size. With huge pages, reserved ones are tried first, then a mapping
+// aligned for transparent ones, to cut TLB misses on random probes.
+char* MapMemory(size_t* bytes) {
+  const int prot = PROT_READ | PROT_WRITE, flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void* memory = MAP_FAILED;
+#if defined(MAP_HUGETLB) && defined(MADV_HUGEPAGE)
+  if (options.huge_pages) {
+    *bytes = (*bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    memory = mmap(nullptr, *bytes, prot, flags | MAP_HUGETLB, -1, 0);
+    if (memory == MAP_FAILED) {
+      auto* padded = static_cast<char*>(mmap(nullptr, *bytes + HUGE_PAGE_SIZE, prot, flags, -1, 0));
+      if (padded != MAP_FAILED) {
+        size_t head = -uintptr_t(padded) & (HUGE_PAGE_SIZE - 1);
+        if (head) munmap(padded, head);
+        munmap(padded + head + *bytes, HUGE_PAGE_SIZE - head);
+        memory = padded + head;
+        madvise(memory, *bytes, MADV_HUGEPAGE);
+      }
+    }
+  }
+#endif
+  if (memory == MAP_FAILED) memory = mmap(nullptr, *bytes, prot, flags, -1, 0);
+  if (memory == MAP_FAILED) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(-1);
+  }
+  return static_cast<char*>(memory);
+}
+
 class Cards {
  public:
   Cards() : bits(0) {}
@@ -308,10 +527,9 @@ class Hands {
   }
 
   void Deal(Cards cards, const std::vector<int>& seats) {
-    std::mt19937 random(static_cast<uint64_t>(Now() * 1000));
     std::vector<int> deck;
     for (int card : cards) deck.push_back(card);
-    std::shuffle(deck.begin(), deck.end(), random);
+    std::shuffle(deck.begin(), deck.end(), SharedRandom());
     int tricks = deck.size() / seats.size();
     for (int seat : seats) {
       for (int i = 0; i < tricks; ++i) {
@@ -321,19 +539,21 @@ class Hands {
     }
   }
 
-  void Decode(const char* code) {
+  // Returns false if the code is not of a full deal.
+  bool Decode(const char* code) {
     uint64_t values[3];
     int num_values = sscanf(code, "%" SCNx64 ",%" SCNx64 ",%" SCNx64, values,
                              values + 1, values + 2);
-    assert(num_values == 3);
+    if (num_values != 3) return false;
     auto mask = (1ULL << TOTAL_CARDS) - 1;
     for (int seat = 0; seat < NUM_SEATS - 1; ++seat) {
       hands[seat] = UnpackBits(values[seat], mask);
       mask &= ~hands[seat].Value();
     }
     hands[NUM_SEATS - 1] = UnpackBits((1ULL << TOTAL_TRICKS) - 1, mask);
-    assert(hands[0].Size() == hands[1].Size() && hands[1].Size() == hands[2].Size() &&
-           hands[2].Size() == hands[3].Size());
+    for (int seat = 0; seat < NUM_SEATS; ++seat)
+      if (hands[seat].Size() != TOTAL_TRICKS) return false;
+    return true;
   }
 
   size_t Size() const {
@@ -345,38 +565,6 @@ class Hands {
   const Cards& operator[](int seat) const { return hands[seat]; }
   Cards& operator[](int seat) { return hands[seat]; }
 
-  // Whether every seat's hand in `other` is a subset of the corresponding
-  // seat's hand here. WEST/NORTH and EAST/SOUTH are each stored as two
-  // contiguous uint64_t, so this can be done with two 128-bit PTESTs instead
-  // of four scalar subset checks chained together.
-  bool Include(const Hands& other) const {
-#ifdef __SSE4_1__
-    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&hands[WEST]));
-    __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&other.hands[WEST]));
-    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&hands[EAST]));
-    __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&other.hands[EAST]));
-    __m128i missing = _mm_or_si128(_mm_andnot_si128(a0, b0), _mm_andnot_si128(a1, b1));
-    return _mm_testz_si128(missing, missing);
-#else
-    return hands[WEST].Include(other.hands[WEST]) & hands[NORTH].Include(other.hands[NORTH]) &
-           hands[EAST].Include(other.hands[EAST]) & hands[SOUTH].Include(other.hands[SOUTH]);
-#endif
-  }
-
-  bool Equals(const Hands& other) const {
-#ifdef __SSE4_1__
-    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&hands[WEST]));
-    __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&other.hands[WEST]));
-    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&hands[EAST]));
-    __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&other.hands[EAST]));
-    __m128i diff = _mm_or_si128(_mm_xor_si128(a0, b0), _mm_xor_si128(a1, b1));
-    return _mm_testz_si128(diff, diff);
-#else
-    return (hands[WEST] == other.hands[WEST]) & (hands[NORTH] == other.hands[NORTH]) &
-           (hands[EAST] == other.hands[EAST]) & (hands[SOUTH] == other.hands[SOUTH]);
-#endif
-  }
-
   int num_tricks() const { return hands[WEST].Size(); }
 
   int num_voids() const {
@@ -395,15 +583,42 @@ class Hands {
     puts("");
   }
 
-  void ShowCode() const {
+  // The unique code of a full deal, understood by Decode().
+  std::string Code() const {
     uint64_t values[3];
     auto mask = (1ULL << TOTAL_CARDS) - 1;
     for (int seat = 0; seat < NUM_SEATS - 1; ++seat) {
       values[seat] = PackBits(hands[seat].Value(), mask);
       mask &= ~hands[seat].Value();
     }
-    printf("# %" PRIX64 ",%" PRIX64 ",%" PRIX64 "\n", values[0], values[1],
-           values[2]);
+    char code[64];
+    snprintf(code, sizeof(code), "%" PRIX64 ",%" PRIX64 ",%" PRIX64, values[0], values[1],
+             values[2]);
+    return code;
+  }
+
+  void ShowCode() const { printf("# %s\n", Code().c_str()); }
+
+  // Moves each hand `rotation` seats clockwise and relabels each suit as
+  // suit_map[suit]. Results are preserved up to the same mapping of seats and
+  // trumps.
+  Hands Transform(int rotation, const int suit_map[NUM_SUITS]) const {
+    Hands transformed;
+    for (int seat = 0; seat < NUM_SEATS; ++seat) {
+      auto& hand = transformed[(seat + rotation) % NUM_SEATS];
+      for (int suit = 0; suit < NUM_SUITS; ++suit) {
+        auto suit_bits = hands[seat].Suit(suit).Value() >> (suit * NUM_RANKS);
+        hand.Add(Cards(suit_bits << (suit_map[suit] * NUM_RANKS)));
+      }
+    }
+    return transformed;
+  }
+
+  bool operator<(const Hands& other) const {
+    for (int seat = 0; seat < NUM_SEATS; ++seat)
+      if (hands[seat] != other.hands[seat])
+        return hands[seat].Value() < other.hands[seat].Value();
+    return false;
   }
 
   void ShowCompact(int rotation = 0) const {
@@ -472,23 +687,207 @@ class Hands {
 
 Hands empty_hands;
 
+// Deals the cards missing from the given hands until each hand has 13 cards
+// and meets its limits, like 'N:P15-17,S5+,H0-4' for the points and the suit
+// lengths of North. Each limit is a number, a range or a minimum.
+class DealGenerator {
+ public:
+  DealGenerator(const Hands& given, const std::vector<char*>& constraints)
+      : given(given) {
+    for (auto* constraint : constraints) {
+      auto& limit = limits[CharToSeat(constraint[0])];
+      if (constraint[1] != ':') BadConstraint(constraint);
+      for (char* item = constraint + 2; *item;) {
+        char kind = toupper(*item++);
+        int *lower, *upper, most;
+        if (kind == 'P') {
+          lower = &limit.min_points, upper = &limit.max_points, most = 37;
+        } else {
+          int suit = CharToSuit(kind);
+          if (suit == NOTRUMP) BadConstraint(constraint);
+          lower = &limit.min_length[suit], upper = &limit.max_length[suit], most = TOTAL_TRICKS;
+        }
+        char* end;
+        *lower = strtol(item, &end, 10);
+        if (end == item) BadConstraint(constraint);
+        if (*end == '+')
+          *upper = most, ++end;
+        else if (*end == '-')
+          *upper = strtol(end + 1, &end, 10);
+        else
+          *upper = *lower;
+        if (*end == ',') ++end;
+        else if (*end) BadConstraint(constraint);
+        item = end;
+      }
+    }
+    for (int card : given.all_cards().Complement()) deck[deck_size++] = card;
+    // Limited seats are dealt first to reject a deal early. The last seat
+    // takes the rest.
+    for (int seat = 0; seat < NUM_SEATS; ++seat) {
+      if (given[seat].Size() > TOTAL_TRICKS) {
+        fprintf(stderr, "%s has more than %d cards.\n", SeatName(seat), TOTAL_TRICKS);
+        exit(-1);
+      }
+      order[seat] = seat;
+    }
+    std::stable_partition(order, order + NUM_SEATS,
+                          [this](int seat) { return limits[seat].limited(); });
+  }
+
+  Hands Next() {
+    for (long long tries = 0; tries < MAX_TRIES; ++tries) {
+      ++num_tries;
+      Hands hands = given;
+      uint64_t dealt = given.all_cards().Value();
+      int size = deck_size;
+      bool good = true;
+      for (int i = 0; i < NUM_SEATS - 1 && good; ++i) {
+        int seat = order[i];
+        uint64_t hand = given[seat].Value();
+        for (int n = given[seat].Size(); n < TOTAL_TRICKS; ++n) {
+          int j = random.Below(size);
+          hand |= uint64_t(1) << deck[j];
+          std::swap(deck[j], deck[--size]);
+        }
+        hands[seat] = hand;
+        dealt |= hand;
+        good = limits[seat].Meet(hand);
+      }
+      int last = order[NUM_SEATS - 1];
+      hands[last].Add(Cards(dealt).Complement());
+      if (good && limits[last].Meet(hands[last].Value())) return hands;
+    }
+    fprintf(stderr, "No deal meets the limits in %lld tries.\n", MAX_TRIES);
+    exit(-1);
+  }
+
+  long long tries() const { return num_tries; }
+
+ private:
+  static constexpr long long MAX_TRIES = 100000000;
+
+  struct Limit {
+    int min_points = 0, max_points = 37;
+    int min_length[NUM_SUITS] = {0, 0, 0, 0};
+    int max_length[NUM_SUITS] = {TOTAL_TRICKS, TOTAL_TRICKS, TOTAL_TRICKS, TOTAL_TRICKS};
+
+    bool limited() const {
+      Limit none;
+      return min_points != none.min_points || max_points != none.max_points ||
+             !std::equal(min_length, min_length + NUM_SUITS, none.min_length) ||
+             !std::equal(max_length, max_length + NUM_SUITS, none.max_length);
+    }
+
+    bool Meet(uint64_t hand) const {
+      // Aces are the first cards of the suits, followed by kings and so on.
+      const uint64_t aces = 0x8004002001ULL;
+      int points = 4 * __builtin_popcountll(hand & aces) +
+                   3 * __builtin_popcountll(hand & aces << 1) +
+                   2 * __builtin_popcountll(hand & aces << 2) +
+                   __builtin_popcountll(hand & aces << 3);
+      if (points < min_points || points > max_points) return false;
+      for (int suit = 0; suit < NUM_SUITS; ++suit) {
+        int length = __builtin_popcountll(hand & MaskOf(suit));
+        if (length < min_length[suit] || length > max_length[suit]) return false;
+      }
+      return true;
+    }
+  };
+
+  static void BadConstraint(const char* constraint) {
+    fprintf(stderr, "Unknown limits: %s\n", constraint);
+    exit(-1);
+  }
+
+  const Hands given;
+  Limit limits[NUM_SEATS];
+  int order[NUM_SEATS];
+  int deck[TOTAL_CARDS];
+  int deck_size = 0;
+  long long num_tries = 0;
+  Random& random = SharedRandom();
+};
+
+// The representative of all deals equivalent under seat rotation and suit
+// relabeling, along with the transform from the original deal to it.
+class CanonicalDeal {
+ public:
+  CanonicalDeal(const Hands& original) {
+    int suit_map[NUM_SUITS] = {SPADE, HEART, DIAMOND, CLUB};
+    bool first = true;
+    do {
+      for (int rotation = 0; rotation < NUM_SEATS; ++rotation) {
+        auto transformed = original.Transform(rotation, suit_map);
+        if (!first && !(transformed < hands)) continue;
+        first = false;
+        hands = transformed;
+        this->rotation = rotation;
+        memcpy(this->suit_map, suit_map, sizeof(suit_map));
+      }
+    } while (std::next_permutation(suit_map, suit_map + NUM_SUITS));
+  }
+
+  const Hands& canonical_hands() const { return hands; }
+  int Trump(int trump) const { return trump == NOTRUMP ? NOTRUMP : suit_map[trump]; }
+  int Seat(int seat) const { return (seat + rotation) % NUM_SEATS; }
+  // NS tricks in one form given NS tricks in the other form.
+  int NsTricks(int ns_tricks) const {
+    return rotation % 2 ? hands.num_tricks() - ns_tricks : ns_tricks;
+  }
+
+ private:
+  Hands hands;
+  int rotation = 0;
+  int suit_map[NUM_SUITS];
+};
+
 template <class Entry>
 class Cache {
  public:
   // The hash is stored in Entry and can vary in size.
   using HashT = decltype(Entry::hash);
+  using EpochT = decltype(Entry::epoch);
 
   Cache(const char* name, int bits)
-      : cache_name(name), bits(bits), size(1 << bits), entries(new Entry[size]) {
+      : cache_name(name), bits(bits), size(1 << bits), entries(NewEntries(size, &entries_bytes)) {
     Reset();
   }
 
+  // Stale entries may still point to released storage.
+  ~Cache() {
+    for (int i = 0; i < size; ++i) entries[i].Reset(0);
+    DeleteEntries(entries, size, entries_bytes);
+  }
+
+  // Entries from epochs before live_epoch count as empty and are reused lazily.
   void Reset() {
     probe_distance = 0;
-    load_count = lookups = lookup_probes = hits = updates = update_probes = 0;
-    for (int i = 0; i < size; ++i) entries[i].Reset(0);
+    load_count = 0;
+    NextEpoch();
+    live_epoch = epoch;
+    // Storage owned by the entries goes at once.
+    Entry::Release();
+  }
+
+  // Keeps the entries for another search, in a new epoch so that lookups can
+  // tell how many of them the search reuses.
+  void Carry() {
+    if (epoch == EpochT(~EpochT(0))) return Reset();
+    NextEpoch();
+    carried = load_count;
+  }
+
+  // Carries the entries to the next search unless they take too much memory.
+  void CarryOrReset() {
+    if (Bytes() > kMaxCarriedBytes)
+      Reset();
+    else
+      Carry();
   }
 
+  size_t Bytes() const { return entries_bytes + Entry::Bytes(); }
+
   void ShowStatistics() const {
     printf("--- %s Statistics ---\n", cache_name);
     printf("lookups: %8d   probes: %8d (%.2f/lookup)   hits: %8d (%5.2f%%)\n",
@@ -498,9 +897,13 @@ class Cache {
     printf("entries: %8d   loaded: %8d (%5.2f%%)\n", size, load_count,
            load_count * 100.0 / size);
 
+    if (carried)
+      printf("carried: %8d   reused: %8d (%5.2f%%)\n", carried, reused,
+             reused * 100.0 / carried);
+
     int recursive_load = 0;
     for (int i = 0; i < size; ++i)
-      if (entries[i].hash != 0) {
+      if (Live(entries[i])) {
         recursive_load += entries[i].Size();
         STATS(if (options.stats_level > 1) entries[i].Show());
       }
@@ -519,17 +922,30 @@ class Cache {
     uint64_t index = hash >> (BitSize(hash) - bits);
 
     for (int d = 0; d < probe_distance; ++d) {
-      const Entry& entry = entries[(index + d) & (size - 1)];
+      Entry& entry = entries[(index + d) & (size - 1)];
+      if (!Live(entry)) break;
       if (entry.hash == hash) {
         STATS(++hits);
+        if (entry.epoch != epoch) Reuse(entry);
         return &entry;
       }
-      if (entry.hash == 0) break;
       STATS(++lookup_probes);
     }
     return nullptr;
   }
 
+  // While concurrent searches share the cache, callers hold Lock() as long as
+  // they use what Lookup() or Update() returns. It is a single mutex over the
+  // whole cache, so every lookup and pattern update at a trick start of every
+  // thread takes it in turn. The shared bounds caches also allocate from the
+  // process-global VectorPool<Pattern>, which has no lock of its own and
+  // relies on this one.
+  void SetShared(bool shared) { this->shared = shared; }
+
+  std::unique_lock<std::mutex> Lock() {
+    return shared ? std::unique_lock<std::mutex>(mutex) : std::unique_lock<std::mutex>();
+  }
+
   Entry* Update(HashT hash) {
     if (load_count >= size * 3 / 4) Resize();
 
@@ -539,11 +955,15 @@ class Cache {
     // Linear probing benefits from hardware prefetch.
     for (int d = 0; ; ++d) {
       Entry& entry = entries[(index + d) & (size - 1)];
-      if (entry.hash == hash) return &entry;
-      if (entry.hash == 0) {
+      if (!Live(entry)) {
         probe_distance = std::max(probe_distance, d + 1);
         ++load_count;
         entry.Reset(hash);
+        entry.epoch = epoch;
+        return &entry;
+      }
+      if (entry.hash == hash) {
+        if (entry.epoch != epoch) Reuse(entry);
         return &entry;
       }
       STATS(++update_probes);
@@ -551,44 +971,88 @@ class Cache {
   }
 
  private:
+  bool Live(const Entry& entry) const { return entry.epoch >= live_epoch; }
+
+  // Moving a carried entry to the current epoch counts it once.
+  void Reuse(Entry& entry) const {
+    entry.epoch = epoch;
+    ++reused;
+  }
+
+  void NextEpoch() {
+    lookups = lookup_probes = hits = updates = update_probes = 0;
+    carried = reused = 0;
+    if (++epoch == 0) {
+      for (int i = 0; i < size; ++i) entries[i].epoch = 0;
+      epoch = 1;
+      live_epoch = 1;
+    }
+  }
+
+  // Entries start zeroed, i.e. in epoch 0, which is never current.
+  static Entry* NewEntries(int size, size_t* bytes) {
+    *bytes = size * sizeof(Entry);
+    auto* entries = reinterpret_cast<Entry*>(MapMemory(bytes));
+    for (int i = 0; i < size; ++i) new (&entries[i]) Entry();
+    return entries;
+  }
+
+  static void DeleteEntries(Entry* entries, int size, size_t bytes) {
+    for (int i = 0; i < size; ++i) entries[i].~Entry();
+    munmap(entries, bytes);
+  }
+
   void Resize() {
-    auto old_entries = std::move(entries);
+    auto* old_entries = entries;
     int old_size = size;
+    size_t old_bytes = entries_bytes;
 
     // Double cache size.
     size = 1 << ++bits;
-    entries.reset(new Entry[size]);
-    CHECK(entries.get());
-    for (int i = 0; i < size; ++i) entries[i].hash = 0;
+    entries = NewEntries(size, &entries_bytes);
 
     // Move entries in the old cache to the new cache.
     load_count = 0;
     probe_distance = 0;
     for (int i = 0; i < old_size; ++i) {
+      if (!Live(old_entries[i])) {
+        old_entries[i].Reset(0);
+        continue;
+      }
       auto hash = old_entries[i].hash;
-      if (hash == 0) continue;
       uint64_t index = hash >> (BitSize(hash) - bits);
       for (int d = 0; ; ++d) {
         Entry& entry = entries[(index + d) & (size - 1)];
-        if (entry.hash == 0) {
+        if (!Live(entry)) {
           probe_distance = std::max(probe_distance, d + 1);
           old_entries[i].MoveTo(entry);
+          entry.epoch = old_entries[i].epoch;
           ++load_count;
           break;
         }
       }
     }
+    DeleteEntries(old_entries, old_size, old_bytes);
   }
 
+  static constexpr size_t kMaxCarriedBytes = size_t{1} << 30;
+
   const char* cache_name;
   int bits;
   int size;
   int probe_distance;
-  std::unique_ptr<Entry[]> entries;
+  size_t entries_bytes;
+  Entry* entries;
+  EpochT epoch = 0;
+  EpochT live_epoch = 0;
+  bool shared = false;
+  std::mutex mutex;
 
   mutable int load_count;
   mutable int lookups, lookup_probes, hits;
   mutable int updates, update_probes;
+  int carried;
+  mutable int reused;
 };
 
 #pragma pack(push, 4)
@@ -638,11 +1102,14 @@ class Shape {
 // Free-list pool for Vector<T>'s backing storage, one LIFO list per
 // power-of-two capacity (size_class == log2(capacity)). Recycles the many
 // short-lived new[]/delete[] calls from Vector<Pattern> churn as the pattern
-// tree is built and pruned; blocks are never freed back to the allocator,
-// only reused. Refill() slabs kSlabSize bytes per malloc call to amortize
-// the call cost -- kept small so a size class's reusable set stays close to
+// tree is built and pruned. Refill() carves kSlabSize bytes at a time out of
+// mapped chunks -- kept small so a size class's reusable set stays close to
 // its actual working set rather than accumulating a large, cold backlog on
-// the biggest pattern trees.
+// the biggest pattern trees. Release() drops every block at once and unmaps
+// all but the first few chunks, so a cache reset needn't walk its trees.
+// The pool isn't thread-safe. While threads share common_bounds_cache, every
+// use goes through that cache's Lock(), and other threads never allocate
+// patterns.
 template <class T>
 class VectorPool {
  public:
@@ -664,8 +1131,25 @@ class VectorPool {
     head = block;
   }
 
+  // Vectors still holding blocks must be abandoned before this.
+  static void Release() {
+    for (auto& head : free_lists_) head = nullptr;
+    while (chunks_.size() > kRetainedChunks) {
+      munmap(chunks_.back(), kChunkSize);
+      chunks_.pop_back();
+    }
+    num_used_chunks_ = 0;
+    chunk_used_ = kChunkSize;
+  }
+
+  // Arena memory handed out to slabs so far.
+  static size_t Bytes() {
+    return num_used_chunks_ ? (num_used_chunks_ - 1) * kChunkSize + chunk_used_ : 0;
+  }
+
   static void ShowStatistics() {
-    printf("--- VectorPool<T> Statistics (block = %zu bytes) ---\n", sizeof(T));
+    printf("--- VectorPool<T> Statistics (block = %zu bytes, chunks = %zu MB) ---\n", sizeof(T),
+           chunks_.size() * kChunkSize >> 20);
     uint64_t total_allocs = 0;
     for (int i = 0; i < 16; ++i) total_allocs += alloc_calls_[i];
     for (int i = 0; i < 16; ++i) {
@@ -679,13 +1163,18 @@ class VectorPool {
 
  private:
   static constexpr size_t kSlabSize = 8192;
+  static constexpr size_t kChunkSize = 4 << 20;
+  static constexpr size_t kRetainedChunks = 4;
 
-  // One allocation for a full slab, amortizing the malloc call across all of them.
+  // One bump of the arena for a full slab.
   static void Refill(int size_class) {
     size_t block_bytes = (size_t{1} << size_class) * sizeof(T);
     size_t num_blocks = kSlabSize / block_bytes;
     if (num_blocks == 0) num_blocks = 1;
-    char* slab = new char[num_blocks * block_bytes];
+    size_t slab_bytes = num_blocks * block_bytes;
+    if (chunk_used_ + slab_bytes > kChunkSize) NextChunk();
+    char* slab = chunks_[num_used_chunks_ - 1] + chunk_used_;
+    chunk_used_ += slab_bytes;
     char*& head = free_lists_[size_class];
     for (size_t i = 0; i < num_blocks; ++i) {
       char* block = slab + i * block_bytes;
@@ -694,9 +1183,21 @@ class VectorPool {
     }
   }
 
+  static void NextChunk() {
+    if (num_used_chunks_ == chunks_.size()) {
+      size_t bytes = kChunkSize;
+      chunks_.push_back(MapMemory(&bytes));
+    }
+    ++num_used_chunks_;
+    chunk_used_ = 0;
+  }
+
   static inline uint64_t alloc_calls_[16] = {};
   static inline uint64_t miss_calls_[16] = {};
   static inline char* free_lists_[16] = {};
+  static inline std::vector<char*> chunks_;
+  static inline size_t num_used_chunks_ = 0;
+  static inline size_t chunk_used_ = kChunkSize;
 };
 
 template <class T>
@@ -714,6 +1215,12 @@ class Vector {
     items = nullptr;
   }
 
+  // Forgets the items without destroying them, for storage the pool releases.
+  void Abandon() {
+    count = capacity = 0;
+    items = nullptr;
+  }
+
   void resize(size_t new_size) {
     if (capacity < new_size) {
       int size_class = new_size <= 1 ? 0 : 32 - __builtin_clz((unsigned)new_size - 1);
@@ -752,20 +1259,106 @@ class Vector {
   char* items = nullptr;
 };
 
+// Hands of a pattern in 16 bytes. A pattern holds the top relative cards of
+// each suit, so a suit is stored as the number of those cards in the upper
+// bits and the seat owning each card in 2 bits, the highest card lowest.
+class PatternHands {
+ public:
+  PatternHands() : suits{} {}
+
+  // Takes the whole suit from relative hands.
+  void SetSuit(int suit, const Hands& relative_hands) {
+    auto suit_bits = [&](int seat) {
+      return uint32_t(relative_hands[seat].Suit(suit).Value() >> (suit * NUM_RANKS));
+    };
+    uint32_t ns = suit_bits(NORTH) | suit_bits(SOUTH), es = suit_bits(EAST) | suit_bits(SOUTH);
+    int depth = __builtin_popcount(ns | es | suit_bits(WEST));
+    suits[suit] = depth << DEPTH_SHIFT | Spread(ns) | Spread(es) << 1;
+  }
+
+  // Takes the top `depth` cards of a suit from other pattern hands.
+  void SetSuit(int suit, const PatternHands& other, int depth) {
+    suits[suit] = depth << DEPTH_SHIFT | (other.suits[suit] & OwnerMask(depth));
+  }
+
+  int Depth(int suit) const { return suits[suit] >> DEPTH_SHIFT; }
+
+  int Size() const { return Depth(SPADE) + Depth(HEART) + Depth(DIAMOND) + Depth(CLUB); }
+
+  // The relative cards held by a seat.
+  Cards operator[](int seat) const {
+    Cards hand;
+    for (int suit = 0; suit < NUM_SUITS; ++suit)
+      for (int i = 0; i < Depth(suit); ++i)
+        if (int((suits[suit] >> (i * 2)) & 3) == seat) hand.Add(suit * NUM_RANKS + i);
+    return hand;
+  }
+
+  // Whether every card in `other` is also here and held by the same seat.
+  // Without check_depth, the suits here must be at least as deep as in `other`.
+  template <bool check_depth = true>
+  bool Include(const PatternHands& other) const {
+#ifdef __SSE4_1__
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(suits));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other.suits));
+    __m128i a_depth = _mm_srli_epi32(a, DEPTH_SHIFT), b_depth = _mm_srli_epi32(b, DEPTH_SHIFT);
+    // SSE has no per-lane shifts, so look up each byte of the owner mask. Byte k
+    // of 4^depth-1 is all ones once depth reaches 4k+4, else 4^(depth-4k)-1.
+    __m128i depths = _mm_shuffle_epi8(b_depth, _mm_set_epi8(12, 12, 12, 12, 8, 8, 8, 8,
+                                                            4, 4, 4, 4, 0, 0, 0, 0));
+    __m128i byte_depths = _mm_subs_epu8(depths, _mm_set1_epi32(0x0c080400));
+    __m128i owner_mask = _mm_shuffle_epi8(
+        _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0x3f, 0x0f, 0x03, 0),
+        byte_depths);
+    __m128i missing = _mm_and_si128(_mm_xor_si128(a, b), owner_mask);
+    if (check_depth) missing = _mm_or_si128(missing, _mm_cmpgt_epi32(b_depth, a_depth));
+    return _mm_testz_si128(missing, missing);
+#else
+    uint32_t missing = 0;
+    for (int suit = 0; suit < NUM_SUITS; ++suit) {
+      int depth = other.Depth(suit);
+      missing |= (suits[suit] ^ other.suits[suit]) & OwnerMask(depth);
+      if (check_depth) missing |= Depth(suit) < depth;
+    }
+    return !missing;
+#endif
+  }
+
+  bool operator==(const PatternHands& other) const {
+    return !memcmp(suits, other.suits, sizeof(suits));
+  }
+
+ private:
+  static constexpr int DEPTH_SHIFT = 2 * NUM_RANKS;
+
+  static uint32_t OwnerMask(int depth) { return (1u << (depth * 2)) - 1; }
+
+  // Moves bit i to bit 2i.
+  static uint32_t Spread(uint32_t bits) {
+    bits = (bits | bits << 8) & 0x00ff00ff;
+    bits = (bits | bits << 4) & 0x0f0f0f0f;
+    bits = (bits | bits << 2) & 0x33333333;
+    return (bits | bits << 1) & 0x55555555;
+  }
+
+  uint32_t suits[NUM_SUITS];
+};
+
 struct Pattern {
-  Hands hands;
+  PatternHands hands;
   Bounds bounds;
   uint16_t order;
   Vector<Pattern> patterns;
 
-  Pattern(const Hands& hands = Hands(), Bounds bounds = Bounds())
+  Pattern(const PatternHands& hands = PatternHands(), Bounds bounds = Bounds())
       : hands(hands), bounds(bounds), order(hands.Size()) {}
 
+  // Leaves the subpatterns to VectorPool<Pattern>::Release().
   void Reset() {
-    hands = Hands();
+    hands = PatternHands();
     bounds = {0, TOTAL_TRICKS};
     order = 0;
-    patterns.clear();
+    patterns.Abandon();
   }
 
   void MoveFrom(Pattern& p) {
@@ -782,10 +1375,11 @@ struct Pattern {
     patterns.swap(p.patterns);
   }
 
+  // The new pattern holds every card left, so it is deep enough in every suit.
   const Pattern* Lookup(const Pattern& new_pattern, int beta) const {
     for (size_t i = 0; i < patterns.size(); ++i) {
       auto& pattern = patterns[i];
-      if (!(new_pattern <= pattern)) continue;
+      if (!new_pattern.hands.Include<false>(pattern.hands)) continue;
       if (pattern.bounds.Cutoff(beta)) return &pattern;
       if (auto detail = pattern.Lookup(new_pattern, beta)) return detail;
     }
@@ -876,14 +1470,13 @@ struct Pattern {
   // This pattern is more detailed than (a subset of) the other pattern.
   bool operator<=(const Pattern& p) const { return hands.Include(p.hands); }
 
-  bool operator==(const Pattern& p) const { return hands.Equals(p.hands); }
+  bool operator==(const Pattern& p) const { return hands == p.hands; }
 
   Cards GetRankWinners(Cards all_cards) const {
-    Cards relative_rank_winners = hands.all_cards();
     Cards rank_winners;
     for (int suit = 0; suit < NUM_SUITS; ++suit) {
-      if (!relative_rank_winners.Suit(suit)) continue;
-      auto packed = relative_rank_winners.Suit(suit).Value() >> (suit * NUM_RANKS);
+      if (!hands.Depth(suit)) continue;
+      auto packed = (1ULL << hands.Depth(suit)) - 1;
       rank_winners.Add(Cards(UnpackBits(packed, all_cards.Suit(suit).Value())));
     }
     return rank_winners;
@@ -919,33 +1512,50 @@ struct Pattern {
   }
 };
 
+// Most shapes are reached with only one or two seats on lead, so the root
+// pattern of a seat is allocated from the pool when the seat first updates
+// it, keeping the slots of the cache small.
 struct ShapeEntry {
   uint64_t hash;
-  mutable Pattern pattern[NUM_SEATS];
+  uint16_t epoch;
+  int8_t root_of[NUM_SEATS];  // Index in roots, or -1 if none
+  mutable Vector<Pattern> roots;
 #ifdef _DEBUG
   Shape shape;
   mutable uint16_t hits[NUM_SEATS], cuts[NUM_SEATS];
 
   void Show() const {
     for (int s = 0; s < NUM_SEATS; ++s) {
-      if (pattern[s].patterns.size() == 0) continue;
+      if (root_of[s] < 0 || roots[root_of[s]].patterns.size() == 0) continue;
+      const auto& root = roots[root_of[s]];
       printf("hash %016lx shape %016lx seat %c size %ld total size %d hits %d cuts %d\n",
-             hash, shape.Value(), SeatLetter(s), pattern[s].patterns.size(),
-             pattern[s].Size() - 1, hits[s], cuts[s]);
-      pattern[s].Show(shape, 0);
+             hash, shape.Value(), SeatLetter(s), root.patterns.size(), root.Size() - 1, hits[s],
+             cuts[s]);
+      root.Show(shape, 0);
     }
   }
 #endif
 
   int Size() const {
     int total = 0;
-    for (int s = 0; s < NUM_SEATS; ++s) total += pattern[s].Size() - 1;
+    for (size_t i = 0; i < roots.size(); ++i) total += roots[i].Size() - 1;
     return total;
   }
 
+  // The root pattern of a seat, allocated at the first update.
+  Pattern& Root(int seat) {
+    if (root_of[seat] < 0) {
+      root_of[seat] = roots.size();
+      roots.resize(roots.size() + 1);
+      roots.back().Reset();
+    }
+    return roots[root_of[seat]];
+  }
+
   void Reset(uint64_t hash_in) {
     hash = hash_in;
-    for (int s = 0; s < NUM_SEATS; ++s) pattern[s].Reset();
+    memset(root_of, -1, sizeof(root_of));
+    roots.Abandon();
 #ifdef _DEBUG
     shape = Shape();
     memset(hits, 0, sizeof(hits));
@@ -953,9 +1563,13 @@ struct ShapeEntry {
 #endif
   }
 
+  static void Release();
+  static size_t Bytes() { return VectorPool<Pattern>::Bytes(); }
+
   void MoveTo(ShapeEntry& to) {
     to.hash = hash;
-    for (int s = 0; s < NUM_SEATS; ++s) to.pattern[s].MoveFrom(pattern[s]);
+    memcpy(to.root_of, root_of, sizeof(root_of));
+    to.roots.swap(roots);
 #ifdef _DEBUG
     to.shape = shape;
     memcpy(to.hits, hits, sizeof(hits));
@@ -963,28 +1577,61 @@ struct ShapeEntry {
 #endif
   }
 
-  std::pair<const Hands*, Bounds> Lookup(const Pattern& new_pattern, int beta, int seat) const {
+  std::pair<const PatternHands*, Bounds> Lookup(const Pattern& new_pattern, int beta,
+                                                 int seat) const {
     STATS(++hits[seat]);
-    if (pattern[seat].bounds.Cutoff(beta) && new_pattern <= pattern[seat]) {
+    if (root_of[seat] < 0) return {nullptr, Bounds{}};
+    auto& root = roots[root_of[seat]];
+    if (root.bounds.Cutoff(beta) && new_pattern <= root) {
       STATS(++cuts[seat]);
-      CHECK(pattern[seat].Lookup(new_pattern, beta));
-      return {&pattern[seat].hands, pattern[seat].bounds};
+      CHECK(root.Lookup(new_pattern, beta));
+      return {&root.hands, root.bounds};
     }
-    auto cached_pattern = pattern[seat].Lookup(new_pattern, beta);
+    auto cached_pattern = root.Lookup(new_pattern, beta);
     if (cached_pattern) {
       STATS(++cuts[seat]);
-      pattern[seat].hands = cached_pattern->hands;
-      pattern[seat].bounds = cached_pattern->bounds;
+      root.hands = cached_pattern->hands;
+      root.bounds = cached_pattern->bounds;
       return {&cached_pattern->hands, cached_pattern->bounds};
     }
     return {nullptr, Bounds{}};
   }
 };
 
+// Bounds of the positions within a trick, keyed by the shape at the trick
+// start and the cards on the table, relative to the cards at the trick start.
+// The hash doesn't fit the whole key, so the key is kept to tell collisions.
+struct TrickEntry : ShapeEntry {
+  Shape trick_shape;
+  uint32_t table;
+
+  bool Match(Shape shape_in, uint32_t table_in) const {
+    return trick_shape == shape_in && table == table_in;
+  }
+
+  void Reset(uint64_t hash_in) {
+    ShapeEntry::Reset(hash_in);
+    trick_shape = Shape();
+    table = 0;
+  }
+
+  // The patterns are in VectorPool<Pattern> with those of the common bounds
+  // cache, whose reset resets this cache too.
+  static void Release() {}
+  static size_t Bytes() { return 0; }
+
+  void MoveTo(TrickEntry& to) {
+    ShapeEntry::MoveTo(to);
+    to.trick_shape = trick_shape;
+    to.table = table;
+  }
+};
+
 struct CutoffEntry {
   // Using 32-bit instead of 64-bit hash is safe because cut-off cards are
   // move-ordering hints and collisions impact performance, not correctness.
   uint32_t hash;
+  uint16_t epoch;
   // Cut-off card depending on the seat to play.
   char card[NUM_SEATS];
 
@@ -997,21 +1644,33 @@ struct CutoffEntry {
     memset(card, TOTAL_CARDS, sizeof(card));
   }
 
+  static void Release() {}
+  static size_t Bytes() { return 0; }
+
   void MoveTo(CutoffEntry& to) { memcpy(&to, this, sizeof(*this)); }
 };
 #pragma pack(pop)
 
+// The common bounds cache resets the trick bounds cache, so it comes second.
+Cache<TrickEntry> trick_bounds_cache("Trick Bounds Cache", 13);
 Cache<ShapeEntry> common_bounds_cache("Common Bounds Cache", 13);
 Cache<CutoffEntry> cutoff_cache("Cut-off Cache", 16);
 
+void ShapeEntry::Release() {
+  trick_bounds_cache.Reset();
+  VectorPool<Pattern>::Release();
+}
+
 struct Trick {
   Shape shape;
   Cards all_cards;
   Hands relative_hands;
+  PatternHands relative_pattern_hands;
   int lead_suit;
 
   // A relative hand contains relative cards.
   void ComputeRelativeHands(int depth, const Hands& hands) {
+    PROFILE(SHAPE);
     if (depth < 4) {
       for (int suit = 0; suit < NUM_SUITS; ++suit)
         ConvertToRelativeSuit(hands, suit, all_cards.Suit(suit));
@@ -1020,6 +1679,7 @@ struct Trick {
       auto prev_trick = this - 1;
       auto prev_trick_cards = prev_trick->all_cards.Different(all_cards);
       relative_hands = prev_trick->relative_hands;
+      relative_pattern_hands = prev_trick->relative_pattern_hands;
       while (prev_trick_cards) {
         auto suit = SuitOf(prev_trick_cards.Top());
         prev_trick_cards.ClearSuit(suit);
@@ -1058,8 +1718,9 @@ struct Trick {
   }
 
   // A pattern hand contains relative cards and rank-irrelevant cards.
-  std::pair<Hands, Cards> ComputePatternHands(Cards rank_winners) const {
+  std::pair<PatternHands, Cards> ComputePatternHands(Cards rank_winners) const {
     Cards relative_rank_winners, extended_rank_winners;
+    PatternHands pattern_hands;
     for (int suit = 0; suit < NUM_SUITS; ++suit) {
       if (!rank_winners.Suit(suit)) continue;
 
@@ -1078,14 +1739,16 @@ struct Trick {
       relative_rank_winners.Add(Cards(MaskOf(suit)).Slice(0, bottom_rank_winner + 1));
       auto packed = relative_rank_winners.Suit(suit).Value() >> (suit * NUM_RANKS);
       extended_rank_winners.Add(Cards(UnpackBits(packed, all_cards.Suit(suit).Value())));
+      int depth = bottom_rank_winner - suit * NUM_RANKS + 1;
+      pattern_hands.SetSuit(suit, relative_pattern_hands, depth);
     }
-
-    Hands pattern_hands;
-    for (int seat = 0; seat < NUM_SEATS; ++seat)
-      pattern_hands[seat] = relative_hands[seat].Intersect(relative_rank_winners);
     return {pattern_hands, extended_rank_winners};
   }
 
+  int RelativeCard(int card, int suit) const {
+    return CardOf(suit, RelativeRank(card, suit));
+  }
+
  private:
   void ConvertToRelativeSuit(const Hands& hands, int suit, Cards all_suit_cards) {
     for (int seat = 0; seat < NUM_SEATS; ++seat) {
@@ -1093,15 +1756,12 @@ struct Trick {
       relative_hands[seat].ClearSuit(suit);
       relative_hands[seat].Add(Cards(packed << (suit * NUM_RANKS)));
     }
+    relative_pattern_hands.SetSuit(suit, relative_hands);
   }
 
   int RelativeRank(int card, int suit) const {
     return ACE - all_cards.Suit(suit).Slice(0, card).Size();
   }
-
-  int RelativeCard(int card, int suit) const {
-    return CardOf(suit, RelativeRank(card, suit));
-  }
 };
 
 struct Stat {
@@ -1114,86 +1774,399 @@ struct Stat {
       printf("%2d: %7d * %.2f  cutoff-collisions: %d\n",
              depth, num_visits, double(num_branches) / num_visits, num_cutoff_collisions);
   }
-} stats[TOTAL_CARDS];
+};
 
-class Play {
- public:
-  Play() {}
-  Play(Play* plays, Trick* trick, Hands& hands, int trump, int depth, int seat_to_play)
-      : plays(plays),
-        trick(trick),
-        hands(hands),
-        trump(trump),
-        depth(depth),
-        seat_to_play(seat_to_play) {}
+// How far a search of a strain and lead has got, for progress reports.
+struct SearchProgress {
+  int trump;
+  int lead_seat;
+  long long nodes;
+  int iteration;
+  Bounds ns_bounds;
+};
 
-  typedef std::pair<int, Cards> Result;  // NS tricks and rank winners
+// Lets another thread cancel Solve(), and lets Solve() report how far it is
+// every progress_nodes nodes.
+struct SolveMonitor {
+  std::atomic<bool> cancelled{false};
+  long long progress_nodes = 1 << 24;
+  std::function<void(const SearchProgress& progress)> progress;
+};
 
-  Result SearchWithCache(int beta) {
-    if (!TrickStarting()) {
-      ns_tricks_won = PreviousPlay().ns_tricks_won;
-      seat_to_play = PreviousPlay().NextSeat();
-      return EvaluatePlayableCards(beta);
-    }
+// Limits for an anytime search. Nodes are counted in batches so the clock is
+// read rarely.
+class SearchBudget {
+ public:
+  SearchBudget(double deadline, long long node_limit, SolveMonitor* monitor, int trump,
+               int lead_seat)
+      : deadline(deadline), node_limit(node_limit), monitor(monitor) {
+    progress = {trump, lead_seat, 0, 0, {0, TOTAL_TRICKS}};
+    if (monitor && monitor->progress) next_report = monitor->progress_nodes;
+  }
 
-    if (depth > 0) {
-      ns_tricks_won = PreviousPlay().ns_tricks_won + PreviousPlay().NsWon();
-      seat_to_play = PreviousPlay().WinningSeat();
-    }
+  bool Expired() const {
+    return (node_limit > 0 && nodes >= node_limit) || (deadline > 0 && Now() >= deadline) ||
+           (monitor && monitor->cancelled);
+  }
 
-    if (ns_tricks_won >= beta) return {ns_tricks_won, {}};
-    const int remaining_tricks = hands.num_tricks();
-    if (ns_tricks_won + remaining_tricks < beta) return {ns_tricks_won + remaining_tricks, {}};
+  long long nodes_searched() const { return nodes; }
 
-    if (remaining_tricks == 1) return CollectLastTrick();
+  void AddNodes(int batch) {
+    long long total = nodes += batch;
+    if (next_report > 0 && total >= next_report) Report(total);
+  }
 
-    trick->all_cards = hands.all_cards();
-    ComputeShape();
-    trick->ComputeRelativeHands(depth, hands);
+  // Called by the test drivers as the bounds narrow.
+  void Update(int iteration, Bounds ns_bounds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    progress.iteration = iteration;
+    progress.ns_bounds = ns_bounds;
+  }
 
-    const auto shape_hash = common_bounds_cache.Hash(trick->shape.Value());
-    auto* shape_entry = common_bounds_cache.Lookup(shape_hash);
-    if (shape_entry) {
-      auto [hands, bounds] =
-          shape_entry->Lookup(trick->relative_hands, beta - ns_tricks_won, seat_to_play);
-      if (hands) {
-        Pattern matched_pattern(*hands, bounds);
-        auto rank_winners = matched_pattern.GetRankWinners(trick->all_cards);
-        VERBOSE(ShowPattern("match", matched_pattern, trick->shape));
-        int lower = bounds.lower + ns_tricks_won;
-        if (lower >= beta) {
-          VERBOSE(printf("%2d: beta cut %d\n", depth, lower));
-          return {lower, rank_winners};
-        }
-        int upper = bounds.upper + ns_tricks_won;
-        VERBOSE(printf("%2d: alpha cut %d\n", depth, upper));
-        return {upper, rank_winners};
-      }
-    }
+ private:
+  void Report(long long total) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (total < next_report) return;
+    next_report = total + std::max(1LL, monitor->progress_nodes);
+    progress.nodes = total;
+    monitor->progress(progress);
+  }
 
-    auto [ns_tricks, rank_winners] = SearchAtTrickStart(beta);
-    auto bounds = ns_tricks < beta
-                      ? Bounds{0, char(ns_tricks - ns_tricks_won)}
-                      : Bounds{char(ns_tricks - ns_tricks_won), char(remaining_tricks)};
+  const double deadline;
+  const long long node_limit;
+  SolveMonitor* const monitor;
+  std::atomic<long long> nodes{0};
+  std::atomic<long long> next_report{0};
+  std::mutex mutex;
+  SearchProgress progress;
+};
+
+// Lets a search be stopped from another thread. A stopped search unwinds
+// right away without updating the bounds cache, so the cache stays valid.
+struct SearchControl {
+  std::atomic<bool> stopped{false};
+  SearchBudget* budget = nullptr;
+  int nodes = 0;
+  Stat stats[TOTAL_CARDS];  // Per search, so parallel searches don't share them.
+
+  void CountNode() {
+    if (!budget || ++nodes < 4096) return;
+    budget->AddNodes(nodes);
+    nodes = 0;
+    if (budget->Expired()) stopped = true;
+  }
+};
+
+// Null-window answers for all positions with a few tricks left, one for each
+// target of the side on lead. A position is
+// indexed by its suit lengths and by the owners of its cards from the top
+// down, which is all that matters once ranks are made relative. Seats are
+// counted from the one on lead and the trump suit is moved first, so the
+// table only has a no-trump half and a trump half.
+class EndgameTable {
+ public:
+  static constexpr int NUM_TRICKS = 2;
+  static constexpr int NUM_CARDS = NUM_TRICKS * NUM_SEATS;
+  static constexpr int ANSWER_BITS = 20;
+
+  EndgameTable() {
+    for (int l0 = 0; l0 <= NUM_CARDS; ++l0)
+      for (int l1 = 0; l0 + l1 <= NUM_CARDS; ++l1)
+        for (int l2 = 0; l0 + l1 + l2 <= NUM_CARDS; ++l2)
+          compositions[l0][l1][l2] = num_compositions++;
+    int counts[NUM_SEATS];
+    for (counts[0] = 0; counts[0] <= NUM_TRICKS; ++counts[0])
+      for (counts[1] = 0; counts[1] <= NUM_TRICKS; ++counts[1])
+        for (counts[2] = 0; counts[2] <= NUM_TRICKS; ++counts[2])
+          for (counts[3] = 0; counts[3] <= NUM_TRICKS; ++counts[3]) {
+            // Number of ways to line up the cards of all seats.
+            uint32_t ways = 1;
+            for (int seat = 0, n = 0; seat < NUM_SEATS; ++seat)
+              for (int i = 1; i <= counts[seat]; ++i) ways = ways * ++n / i;
+            Multinomial(counts) = ways;
+          }
+    for (int seat = 0; seat < NUM_SEATS; ++seat) counts[seat] = NUM_TRICKS;
+    num_owner_orders = Multinomial(counts);
+  }
+
+  size_t Size() const { return size_t(2) * num_compositions * num_owner_orders; }
+  bool IsLoaded() const { return entries != nullptr; }
+
+  void Load(const char* file_name) {
+    struct stat file_stat;
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0 || fstat(fd, &file_stat) != 0 ||
+        size_t(file_stat.st_size) != Size() * sizeof(uint64_t)) {
+      fprintf(stderr, "Invalid endgame table %s.\n", file_name);
+      exit(-1);
+    }
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      fprintf(stderr, "Failed to map endgame table %s.\n", file_name);
+      exit(-1);
+    }
+    entries = static_cast<const uint64_t*>(data);
+  }
+
+  size_t Index(const Hands& hands, int trump, int seat_to_play) const {
+    int suits[NUM_SUITS], lengths[NUM_SUITS], counts[NUM_SEATS];
+    OrderSuits(trump, suits);
+    for (int seat = 0; seat < NUM_SEATS; ++seat) counts[seat] = NUM_TRICKS;
+    auto all_cards = hands.all_cards();
+    size_t owner_order = 0;
+    for (int i = 0; i < NUM_SUITS; ++i) {
+      auto suit_cards = all_cards.Suit(suits[i]);
+      lengths[i] = suit_cards.Size();
+      for (int card : suit_cards) {
+        int owner = 0;
+        while (!hands[(seat_to_play + owner) % NUM_SEATS].Have(card)) ++owner;
+        // Count the orders that have a seat closer to the leader here.
+        for (int seat = 0; seat < owner; ++seat) {
+          if (counts[seat] == 0) continue;
+          --counts[seat];
+          owner_order += Multinomial(counts);
+          ++counts[seat];
+        }
+        --counts[owner];
+      }
+    }
+    size_t composition = compositions[lengths[0]][lengths[1]][lengths[2]];
+    return ((trump != NOTRUMP) * num_compositions + composition) * num_owner_orders + owner_order;
+  }
+
+  // Answers whether the side on lead takes at least the target of tricks, as
+  // a null-window search would: a bound on its tricks and the rank winners.
+  std::pair<int, Cards> Lookup(const Hands& hands, int trump, int seat_to_play,
+                               int target) const {
+    auto entry = entries[Index(hands, trump, seat_to_play)];
+    int suits[NUM_SUITS];
+    OrderSuits(trump, suits);
+    auto all_cards = hands.all_cards();
+    Cards rank_winners;
+    for (int i = 0; i < NUM_SUITS; ++i) {
+      auto suit_cards = all_cards.Suit(suits[i]);
+      for (int depth = Depth(entry, target, i); depth > 0; --depth) {
+        rank_winners.Add(suit_cards.Top());
+        suit_cards.Remove(suit_cards.Top());
+      }
+    }
+    return {Tricks(entry, target), rank_winners};
+  }
+
+  // An answer packs a bound on the tricks of the side on lead with, for each
+  // suit in table order, the depth of rank winners from the top.
+  static uint64_t Encode(int target, int tricks, const int depths[NUM_SUITS]) {
+    uint64_t answer = tricks;
+    for (int i = 0; i < NUM_SUITS; ++i) answer |= depths[i] << (4 + i * 4);
+    return answer << ((target - 1) * ANSWER_BITS);
+  }
+  static int Tricks(uint64_t entry, int target) {
+    return (entry >> ((target - 1) * ANSWER_BITS)) & 15;
+  }
+  static int Depth(uint64_t entry, int target, int i) {
+    return (entry >> ((target - 1) * ANSWER_BITS + 4 + i * 4)) & 15;
+  }
+
+ private:
+  static void OrderSuits(int trump, int suits[NUM_SUITS]) {
+    int i = 0;
+    if (trump != NOTRUMP) suits[i++] = trump;
+    for (int suit = 0; suit < NUM_SUITS; ++suit)
+      if (suit != trump) suits[i++] = suit;
+  }
+
+  uint32_t& Multinomial(const int counts[NUM_SEATS]) {
+    return multinomials[counts[0]][counts[1]][counts[2]][counts[3]];
+  }
+  uint32_t Multinomial(const int counts[NUM_SEATS]) const {
+    return multinomials[counts[0]][counts[1]][counts[2]][counts[3]];
+  }
+
+  int compositions[NUM_CARDS + 1][NUM_CARDS + 1][NUM_CARDS + 1];
+  int num_compositions = 0;
+  uint32_t multinomials[NUM_TRICKS + 1][NUM_TRICKS + 1][NUM_TRICKS + 1][NUM_TRICKS + 1];
+  uint32_t num_owner_orders;
+  const uint64_t* entries = nullptr;
+} endgame_table;
+
+class Play {
+ public:
+  Play() {}
+  Play(Play* plays, Trick* trick, Hands& hands, int trump, int depth, int seat_to_play,
+       SearchControl* control, Cache<CutoffEntry>* cutoffs)
+      : plays(plays),
+        trick(trick),
+        hands(hands),
+        trump(trump),
+        depth(depth),
+        control(control),
+        cutoffs(cutoffs),
+        seat_to_play(seat_to_play) {}
+
+  typedef std::pair<int, Cards> Result;  // NS tricks and rank winners
+
+  Result SearchWithCache(int beta) {
+    PROFILE(SEARCH);
+    control->CountNode();
+    if (!TrickStarting()) {
+      ns_tricks_won = PreviousPlay().ns_tricks_won;
+      seat_to_play = PreviousPlay().NextSeat();
+      if (!options.trick_cache_tricks ||
+          trick->all_cards.Size() < options.trick_cache_tricks * NUM_SEATS)
+        return EvaluatePlayableCards(beta);
+      return SearchWithinTrick(beta);
+    }
+
+    if (depth > 0) {
+      ns_tricks_won = PreviousPlay().ns_tricks_won + PreviousPlay().NsWon();
+      seat_to_play = PreviousPlay().WinningSeat();
+    }
+
+    if (ns_tricks_won >= beta) return {ns_tricks_won, {}};
+    const int remaining_tricks = hands.num_tricks();
+    if (ns_tricks_won + remaining_tricks < beta) return {ns_tricks_won + remaining_tricks, {}};
+
+    if (remaining_tricks == 1) return CollectLastTrick();
+    if (remaining_tricks == EndgameTable::NUM_TRICKS && endgame_table.IsLoaded()) {
+      int target = NsToPlay() ? beta - ns_tricks_won : ns_tricks_won + remaining_tricks - beta + 1;
+      auto [tricks, rank_winners] = endgame_table.Lookup(hands, trump, seat_to_play, target);
+      return {ns_tricks_won + (NsToPlay() ? tricks : remaining_tricks - tricks), rank_winners};
+    }
+
+    trick->all_cards = hands.all_cards();
+    ComputeShape();
+    trick->ComputeRelativeHands(depth, hands);
+
+    const auto shape_hash = common_bounds_cache.Hash(trick->shape.Value());
+    auto lock = common_bounds_cache.Lock();
+    {
+      PROFILE(LOOKUP);
+      auto* shape_entry = common_bounds_cache.Lookup(shape_hash);
+      if (shape_entry) {
+        auto [hands, bounds] =
+            shape_entry->Lookup(trick->relative_pattern_hands, beta - ns_tricks_won, seat_to_play);
+        if (hands) {
+          // Copy the match so other threads can go on while it is used.
+          Pattern matched_pattern(*hands, bounds);
+          if (lock) lock.unlock();
+          auto rank_winners = matched_pattern.GetRankWinners(trick->all_cards);
+          VERBOSE(ShowPattern("match", matched_pattern, trick->shape));
+          int lower = bounds.lower + ns_tricks_won;
+          if (lower >= beta) {
+            VERBOSE(printf("%2d: beta cut %d\n", depth, lower));
+            return {lower, rank_winners};
+          }
+          int upper = bounds.upper + ns_tricks_won;
+          VERBOSE(printf("%2d: alpha cut %d\n", depth, upper));
+          return {upper, rank_winners};
+        }
+      }
+    }
+    if (lock) lock.unlock();
+
+    auto [ns_tricks, rank_winners] = SearchAtTrickStart(beta);
+    if (Stopped()) return {ns_tricks, rank_winners};
+    PROFILE(UPDATE);
+    auto bounds = ns_tricks < beta
+                      ? Bounds{0, char(ns_tricks - ns_tricks_won)}
+                      : Bounds{char(ns_tricks - ns_tricks_won), char(remaining_tricks)};
 
     auto [pattern_hands, extended_rank_winners] = trick->ComputePatternHands(rank_winners);
+    if (lock.mutex()) lock.lock();
     Pattern new_pattern(pattern_hands, bounds);
     VERBOSE(ShowPattern("update", new_pattern, trick->shape));
     auto* new_shape_entry = common_bounds_cache.Update(shape_hash);
 #ifdef _DEBUG
     new_shape_entry->shape = trick->shape;
 #endif
-    new_shape_entry->pattern[seat_to_play].Update(new_pattern);
+    new_shape_entry->Root(seat_to_play).Update(new_pattern);
     return {ns_tricks, extended_rank_winners};
   }
 
+  // Like the trick start above, with the cards on the table in the key.
+  Result SearchWithinTrick(int beta) {
+    const int remaining_tricks = trick->all_cards.Size() / NUM_SEATS;
+    const auto table = TableIndex();
+    const auto hash =
+        trick_bounds_cache.Hash(trick->shape.Value() + table * 0x9e3779b97f4a7c15ULL);
+    // The common bounds cache's lock covers VectorPool<Pattern> too.
+    auto lock = common_bounds_cache.Lock();
+    {
+      PROFILE(LOOKUP);
+      auto* entry = trick_bounds_cache.Lookup(hash);
+      if (entry && entry->Match(trick->shape, table)) {
+        auto [hands, bounds] =
+            entry->Lookup(trick->relative_pattern_hands, beta - ns_tricks_won, seat_to_play);
+        if (hands) {
+          Pattern matched_pattern(*hands, bounds);
+          if (lock) lock.unlock();
+          auto rank_winners = matched_pattern.GetRankWinners(trick->all_cards);
+          int lower = bounds.lower + ns_tricks_won;
+          if (lower >= beta) return {lower, rank_winners};
+          return {bounds.upper + ns_tricks_won, rank_winners};
+        }
+      }
+    }
+    if (lock) lock.unlock();
+
+    auto [ns_tricks, rank_winners] = EvaluatePlayableCards(beta);
+    if (Stopped()) return {ns_tricks, rank_winners};
+    PROFILE(UPDATE);
+    auto bounds = ns_tricks < beta
+                      ? Bounds{0, char(ns_tricks - ns_tricks_won)}
+                      : Bounds{char(ns_tricks - ns_tricks_won), char(remaining_tricks)};
+
+    auto [pattern_hands, extended_rank_winners] = trick->ComputePatternHands(rank_winners);
+    if (lock.mutex()) lock.lock();
+    Pattern new_pattern(pattern_hands, bounds);
+    auto* entry = trick_bounds_cache.Update(hash);
+    if (!entry->Match(trick->shape, table)) {
+      entry->Reset(hash);
+      entry->trick_shape = trick->shape;
+      entry->table = table;
+    }
+    entry->Root(seat_to_play).Update(new_pattern);
+    return {ns_tricks, extended_rank_winners};
+  }
+
+  // Proven bounds on NS tricks from the static evaluation at a trick start.
+  Bounds StaticBounds() {
+    trick->all_cards = hands.all_cards();
+    int remaining_tricks = hands.num_tricks();
+    int lower = LeaderTricks().first, upper = remaining_tricks - DefenderTricks().first;
+    if (!NsToPlay()) std::tie(lower, upper) = std::make_pair(remaining_tricks - upper,
+                                                             remaining_tricks - lower);
+    return {char(ns_tricks_won + lower), char(ns_tricks_won + upper)};
+  }
+
  private:
-  Result SearchAtTrickStart(int beta) {
+  // Tricks the side on lead can take right away.
+  Result LeaderTricks() const {
+    PROFILE(STATIC);
     auto [fast_tricks, fast_rank_winners] = FastTricks();
     if (fast_tricks == 0 && trump != NOTRUMP)
       std::tie(fast_tricks, fast_rank_winners) =
         SlowTrumpTricks(hands[seat_to_play].Suit(trump), hands[Partner()].Suit(trump),
                         hands[LeftHandOpp()].Suit(trump), hands[RightHandOpp()].Suit(trump), true);
+    return {fast_tricks, fast_rank_winners};
+  }
+
+  // Tricks the defending side is sure to take eventually.
+  Result DefenderTricks() const {
+    PROFILE(STATIC);
+    auto [slow_tricks, slow_rank_winners] = trick->all_cards.Suit(trump)
+        ? TopTrumpTricks(hands[LeftHandOpp()].Suit(trump), hands[RightHandOpp()].Suit(trump))
+        : SlowNoTrumpTricks(hands[seat_to_play], hands[Partner()]);
+    if (slow_tricks == 0 && trick->all_cards.Suit(trump))
+      std::tie(slow_tricks, slow_rank_winners) =
+        SlowTrumpTricks(hands[LeftHandOpp()].Suit(trump), hands[RightHandOpp()].Suit(trump),
+                        hands[Partner()].Suit(trump), hands[seat_to_play].Suit(trump), false);
+    return {slow_tricks, slow_rank_winners};
+  }
+
+  Result SearchAtTrickStart(int beta) {
+    auto [fast_tricks, fast_rank_winners] = LeaderTricks();
     if (NsToPlay() && ns_tricks_won + fast_tricks >= beta) {
       VERBOSE(printf("%2d: beta fast cut %d+%d\n", depth, ns_tricks_won, fast_tricks));
       return {ns_tricks_won + fast_tricks, fast_rank_winners};
@@ -1204,13 +2177,7 @@ class Play {
                      remaining_tricks - fast_tricks));
       return {ns_tricks_won + (remaining_tricks - fast_tricks), fast_rank_winners};
     }
-    auto [slow_tricks, slow_rank_winners] = trick->all_cards.Suit(trump)
-        ? TopTrumpTricks(hands[LeftHandOpp()].Suit(trump), hands[RightHandOpp()].Suit(trump))
-        : SlowNoTrumpTricks(hands[seat_to_play], hands[Partner()]);
-    if (slow_tricks == 0 && trick->all_cards.Suit(trump))
-      std::tie(slow_tricks, slow_rank_winners) =
-        SlowTrumpTricks(hands[LeftHandOpp()].Suit(trump), hands[RightHandOpp()].Suit(trump),
-                        hands[Partner()].Suit(trump), hands[seat_to_play].Suit(trump), false);
+    auto [slow_tricks, slow_rank_winners] = DefenderTricks();
     if (NsToPlay() && ns_tricks_won + (remaining_tricks - slow_tricks) < beta) {
       VERBOSE(printf("%2d: alpha slow cut %d+%d\n", depth, ns_tricks_won,
                      remaining_tricks - slow_tricks));
@@ -1224,19 +2191,19 @@ class Play {
   }
 
   Result EvaluatePlayableCards(int beta) {
-    STATS(++stats[depth].num_visits);
+    STATS(++control->stats[depth].num_visits);
     ordered_cards.Reset();
     auto playable_cards = GetPlayableCards();
     VERBOSE(printf("%2d: all %lx playable %lx\n", depth, hands.all_cards().Value(),
                    playable_cards.Value()));
-    const auto cutoff_hash = cutoff_cache.Hash(BuildCutoffIndex());
+    const auto cutoff_hash = cutoffs->Hash(BuildCutoffIndex());
     int cutoff_card = LookupCutoffCard(cutoff_hash);
     if (playable_cards.Have(cutoff_card)) {
       VERBOSE(printf("%2d: use cutoff %s\n", depth, NameOf(cutoff_card)));
       ordered_cards.AddCard(cutoff_card);
       playable_cards.Remove(cutoff_card);
     } else {
-      STATS(if (cutoff_card != TOTAL_CARDS) ++stats[depth].num_cutoff_collisions);
+      STATS(if (cutoff_card != TOTAL_CARDS) ++control->stats[depth].num_cutoff_collisions);
       OrderCards(playable_cards);
       playable_cards = Cards();
     }
@@ -1250,7 +2217,7 @@ class Play {
       // Try a card if its rank is still relevant and it isn't equivalent to a tried card.
       if (rank >= min_relevant_ranks[suit] &&
           !trick->IsEquivalent(card, tried_cards.Suit(suit), hands[seat_to_play])) {
-        STATS(++stats[depth].num_branches);
+        STATS(++control->stats[depth].num_branches);
         STATS(++num_branches);
         PlayCard(card);
         VERBOSE(ShowTricks(beta, 0, true));
@@ -1258,6 +2225,7 @@ class Play {
         if (TrickEnding()) branch_rank_winners.Add(GetTrickRankWinner());
         VERBOSE(ShowTricks(beta, branch_ns_tricks, false));
         UnplayCard();
+        if (Stopped()) return {branch_ns_tricks, {}};
 
         ns_tricks = NsToPlay() ? std::max(ns_tricks, branch_ns_tricks)
                                : std::min(ns_tricks, branch_ns_tricks);
@@ -1372,6 +2340,7 @@ class Play {
   }
 
   void OrderCards(Cards playable_cards) {
+    PROFILE(ORDER);
     if (!playable_cards) return;
     if (playable_cards.Size() == 1) {
       ordered_cards.AddCard(playable_cards.Top());
@@ -1480,6 +2449,7 @@ class Play {
   };
 
   void ComputeShape() const {
+    PROFILE(SHAPE);
     if (depth < 4) {
       trick->shape = Shape(hands);
     } else {
@@ -1534,6 +2504,18 @@ class Play {
     hands[seat_to_play].Add(card_played);
   }
 
+  // The seat on lead and the relative cards on the table, after a 1 bit that
+  // tells how many there are.
+  uint32_t TableIndex() const {
+    int start = depth & ~3;
+    uint32_t index = NUM_SEATS | plays[start].seat_to_play;
+    for (int d = start; d < depth; ++d) {
+      int card = plays[d].card_played;
+      index = index << 6 | trick->RelativeCard(card, SuitOf(card));
+    }
+    return index;
+  }
+
   uint64_t BuildCutoffIndex() const {
     // Format of the index:
     //  * 2 bits for seating order in the trick
@@ -1554,12 +2536,14 @@ class Play {
   }
 
   int LookupCutoffCard(decltype(cutoff_cache)::HashT hash) const {
-    const auto* entry = cutoff_cache.Lookup(hash);
+    PROFILE(ORDER);
+    const auto* entry = cutoffs->Lookup(hash);
     return entry ? entry->card[seat_to_play] : TOTAL_CARDS;
   }
 
   void SaveCutoffCard(decltype(cutoff_cache)::HashT hash, int cutoff_card) const {
-    auto* entry = cutoff_cache.Update(hash);
+    PROFILE(ORDER);
+    auto* entry = cutoffs->Update(hash);
     entry->card[seat_to_play] = cutoff_card;
   }
 
@@ -1664,10 +2648,11 @@ class Play {
           if (pd_winners <= pd_max_rank_winners) pd_rank_winners.Add(card);
         } else
           break;
+      int opp_length = std::max(lho_suit.Size(), rho_suit.Size());
       my_tricks +=
-          SuitFastTricks(my_suit, my_winners, my_entry, pd_suit, pd_winners);
+          SuitFastTricks(my_suit, my_winners, my_entry, pd_suit, pd_winners, opp_length);
       pd_tricks += SuitFastTricks(pd_suit, pd_winners, pd_entry,
-                                       my_suit, my_winners);
+                                       my_suit, my_winners, opp_length);
     }
     if (pd_entry) {
       fast_tricks = std::max(my_tricks, pd_tricks);
@@ -1678,10 +2663,12 @@ class Play {
   }
 
   int SuitFastTricks(Cards my_suit, int my_winners, bool& my_entry, Cards pd_suit,
-                     int pd_winners) const {
+                     int pd_winners, int opp_length) const {
     // Entry from partner if my top winner can cover partner's bottom card.
     if (pd_suit && my_winners > 0 && HigherRank(my_suit.Top(), pd_suit.Bottom()))
       my_entry = true;
+    // Partner is void, so my small cards win once opponents are exhausted.
+    if (!pd_suit && my_winners >= opp_length) return my_suit.Size();
     // Partner has no winners.
     if (pd_winners == 0) return my_winners;
     // Cash all my winners, then partner's.
@@ -1754,6 +2741,7 @@ class Play {
   int WinningCard() const { return plays[winning_play].card_played; }
   int WinningSeat() const { return plays[winning_play].seat_to_play; }
   int LeadSuit() const { return trick->lead_suit; }
+  bool Stopped() const { return control->stopped.load(std::memory_order_relaxed); }
   int NextSeat(int count = 1) const { return (seat_to_play + count) & (NUM_SEATS - 1); }
   int LeftHandOpp() const { return NextSeat(1); }
   int Partner() const { return NextSeat(2); }
@@ -1767,6 +2755,8 @@ class Play {
   Hands& hands = empty_hands;
   const int trump = NOTRUMP;
   const int depth = 0;
+  SearchControl* const control = nullptr;
+  Cache<CutoffEntry>* const cutoffs = &cutoff_cache;
 
   // Per play info.
   int ns_tricks_won = 0;
@@ -1776,31 +2766,49 @@ class Play {
   OrderedCards ordered_cards;
 
   friend class InteractivePlay;
-#ifdef _WEB
+  friend class PlayAnalysis;
   friend class WebPlay;
-#endif  // _WEB
+  friend class SingleDummy;
 };
 
 class MinMax {
  public:
-  MinMax(const Hands& hands_in, int trump, int seat_to_play) : hands(hands_in) {
+  MinMax(const Hands& hands_in, int trump, int seat_to_play,
+         Cache<CutoffEntry>* cutoffs = &cutoff_cache)
+      : hands(hands_in) {
     for (int i = 0; i < TOTAL_CARDS; ++i)
-      new (&plays[i]) Play(plays, tricks + i / 4, hands, trump, i, seat_to_play);
-    if (options.stats_level) memset((void*)stats, 0, sizeof(stats));
+      new (&plays[i])
+          Play(plays, tricks + i / 4, hands, trump, i, seat_to_play, &control, cutoffs);
   }
 
   ~MinMax() {
     if (options.stats_level) {
       puts("");
-      for (int i = 0; i < TOTAL_CARDS; ++i) stats[i].Show(i);
+      for (int i = 0; i < TOTAL_CARDS; ++i) control.stats[i].Show(i);
     }
   }
 
   int Search(int beta) { return plays[0].SearchWithCache(beta).first; }
 
+  Bounds StaticBounds() { return plays[0].StaticBounds(); }
+
+  // Stops a search running in another thread. The stop lasts until Resume().
+  void Stop() { control.stopped = true; }
+  void Resume() { control.stopped = false; }
+  bool Stopped() const { return control.stopped; }
+  // Stops searches by itself once the budget runs out.
+  void SetBudget(SearchBudget* budget) {
+    control.budget = budget;
+    control.nodes = 0;
+  }
+
   Play& play(int i) { return plays[i]; }
 
+  // Includes the nodes not yet added to the budget.
+  long long nodes_searched() const { return control.budget->nodes_searched() + control.nodes; }
+
  private:
+  SearchControl control;
   Hands hands;
   Play plays[TOTAL_CARDS];
   Trick tricks[TOTAL_TRICKS];
@@ -1873,6 +2881,8 @@ void ReadHands(Hands& hands, std::vector<int>& trumps, std::vector<int>& lead_se
   for (int seat = 0; seat < NUM_SEATS; ++seat) {
     hands[seat] = ParseHand(line[seat], all_cards);
     all_cards.Add(hands[seat]);
+    // The deal generator fills partial hands.
+    if (options.num_deals > 0) continue;
     if (num_tricks == 0 && hands[seat])
       num_tricks = hands[seat].Size();
     else if (hands[seat] && hands[seat].Size() != num_tricks) {
@@ -1899,26 +2909,261 @@ void ReadHands(Hands& hands, std::vector<int>& trumps, std::vector<int>& lead_se
   fclose(input_file);
 }
 
-int MemoryEnhancedTestDriver(const std::function<int(int)>& search, int num_tricks,
-                             int guess_tricks) {
-  int upperbound = num_tricks;
-  int lowerbound = 0;
-  int ns_tricks = guess_tricks;
+// Returns the proven bounds, which meet unless the budget runs out first.
+Bounds MemoryEnhancedTestDriver(const std::function<int(int)>& search, int num_tricks,
+                                int guess_tricks, Bounds known_bounds = {0, TOTAL_TRICKS},
+                                SearchBudget* budget = nullptr) {
+  int upperbound = std::min<int>(num_tricks, known_bounds.upper);
+  int lowerbound = known_bounds.lower;
+  int ns_tricks = std::clamp(guess_tricks, lowerbound, upperbound);
   if (options.displaying_depth > 0)
     printf("Lowerbound: %d\tUpperbound: %d\n", lowerbound, upperbound);
-  while (lowerbound < upperbound) {
+  for (int iteration = 1; lowerbound < upperbound; ++iteration) {
+    if (budget && budget->Expired()) break;
     int beta = (ns_tricks == lowerbound ? ns_tricks + 1 : ns_tricks);
     ns_tricks = search(beta);
+    // A stopped search proves nothing.
+    if (budget && budget->Expired()) break;
     if (ns_tricks < beta)
       upperbound = ns_tricks;
     else
       lowerbound = ns_tricks;
+    if (budget) budget->Update(iteration, {char(lowerbound), char(upperbound)});
     if (options.displaying_depth > 0)
       printf("Lowerbound: %d\tUpperbound: %d\n", lowerbound, upperbound);
   }
-  return ns_tricks;
+  return {char(lowerbound), char(upperbound)};
+}
+
+#ifndef _WEB
+// Searches every endgame position for each target of the side on lead, then
+// drops rank winners as long as every position matching the smaller pattern
+// gives the same answer. Positions have West on lead and spades as trumps if
+// any, so table order is plain suit order.
+void BuildEndgameTable(const char* file_name) {
+  constexpr int N = EndgameTable::NUM_TRICKS;
+  int stats_level = options.stats_level;
+  options.stats_level = 0;
+  std::vector<uint64_t> entries(endgame_table.Size());
+  std::vector<char> leader_tricks(endgame_table.Size());
+
+  auto to_hands = [](const int lengths[NUM_SUITS], const std::vector<int>& owners) {
+    Hands hands;
+    for (int suit = 0, i = 0; suit < NUM_SUITS; ++suit)
+      for (int rank = ACE; rank > ACE - lengths[suit]; --rank)
+        hands[owners[i++]].Add(CardOf(suit, rank));
+    return hands;
+  };
+  // Positions are given by suit lengths and the owners of cards from the top down.
+  auto for_each_position = [](const std::function<void(const int*, std::vector<int>&)>& visit) {
+    int lengths[NUM_SUITS];
+    for (lengths[0] = 0; lengths[0] <= N * NUM_SEATS; ++lengths[0])
+      for (lengths[1] = 0; lengths[0] + lengths[1] <= N * NUM_SEATS; ++lengths[1])
+        for (lengths[2] = 0; lengths[0] + lengths[1] + lengths[2] <= N * NUM_SEATS; ++lengths[2]) {
+          lengths[3] = N * NUM_SEATS - lengths[0] - lengths[1] - lengths[2];
+          std::vector<int> owners;
+          for (int seat = 0; seat < NUM_SEATS; ++seat) owners.insert(owners.end(), N, seat);
+          do visit(lengths, owners);
+          while (std::next_permutation(owners.begin(), owners.end()));
+        }
+  };
+  // A pattern fixes the owners of the rank winners and only the lengths below.
+  std::function<void(const int*, std::vector<int>&, const int*, int, int,
+                     const std::function<void(const Hands&)>&)> for_each_match =
+      [&](const int lengths[NUM_SUITS], std::vector<int>& owners, const int depths[NUM_SUITS],
+          int suit, int start, const std::function<void(const Hands&)>& visit) {
+        if (suit == NUM_SUITS) {
+          visit(to_hands(lengths, owners));
+          return;
+        }
+        auto begin = owners.begin() + start + depths[suit], end = owners.begin() + start + lengths[suit];
+        std::vector<int> original(begin, end);
+        std::sort(begin, end);
+        do for_each_match(lengths, owners, depths, suit + 1, start + lengths[suit], visit);
+        while (std::next_permutation(begin, end));
+        std::copy(original.begin(), original.end(), begin);
+      };
+
+  for (int trump : {int(NOTRUMP), int(SPADE)}) {
+    for_each_position([&](const int* lengths, std::vector<int>& owners) {
+      auto hands = to_hands(lengths, owners);
+      auto all_cards = hands.all_cards();
+      auto index = endgame_table.Index(hands, trump, WEST);
+      // West leads, so North-South fail the target exactly when West does not.
+      MinMax min_max(hands, trump, WEST);
+      for (int target = 1; target <= N; ++target) {
+        auto [ns_tricks, rank_winners] = min_max.play(0).SearchWithCache(N - target + 1);
+        int depths[NUM_SUITS] = {0};
+        for (int suit = 0; suit < NUM_SUITS; ++suit)
+          if (auto suit_rank_winners = rank_winners.Suit(suit))
+            depths[suit] = all_cards.Suit(suit).Slice(0, suit_rank_winners.Bottom() + 1).Size();
+        entries[index] |= EndgameTable::Encode(target, N - ns_tricks, depths);
+        leader_tricks[index] += N - ns_tricks >= target;
+      }
+    });
+    common_bounds_cache.Reset();
+    cutoff_cache.Reset();
+
+    for_each_position([&](const int* lengths, std::vector<int>& owners) {
+      auto index = endgame_table.Index(to_hands(lengths, owners), trump, WEST);
+      uint64_t entry = 0;
+      for (int target = 1; target <= N; ++target) {
+        bool reached = leader_tricks[index] >= target;
+        int depths[NUM_SUITS], tricks;
+        auto check = [&](const Hands& hands) {
+          int match_tricks = leader_tricks[endgame_table.Index(hands, trump, WEST)];
+          if ((match_tricks >= target) != reached) tricks = -1;
+          if (tricks >= 0)
+            tricks = reached ? std::min(tricks, match_tricks) : std::max(tricks, match_tricks);
+        };
+        for (int suit = 0; suit < NUM_SUITS; ++suit)
+          depths[suit] = EndgameTable::Depth(entries[index], target, suit);
+        for (int suit = 0; suit < NUM_SUITS; ++suit)
+          while (depths[suit] > 0) {
+            --depths[suit];
+            tricks = leader_tricks[index];
+            for_each_match(lengths, owners, depths, 0, 0, check);
+            if (tricks < 0) {
+              ++depths[suit];
+              break;
+            }
+          }
+        tricks = leader_tricks[index];
+        for_each_match(lengths, owners, depths, 0, 0, check);
+        entry |= EndgameTable::Encode(target, tricks, depths);
+      }
+      entries[index] = entry;
+    });
+  }
+  options.stats_level = stats_level;
+
+  FILE* file = fopen(file_name, "wb");
+  if (!file || fwrite(entries.data(), sizeof(entries[0]), entries.size(), file) != entries.size() ||
+      fclose(file) != 0) {
+    fprintf(stderr, "Failed to write endgame table %s.\n", file_name);
+    exit(-1);
+  }
 }
 
+// Runs null-window probes at several betas at once, nearest to the MTD(f)
+// choice first. The probes share the bounds cache, while each thread has its
+// own MinMax and cut-off cache. A probe is stopped as soon as its beta falls
+// out of the bracket narrowed by the others. The workers last for a strain,
+// so their cut-off caches can be carried from one lead to the next.
+class ParallelTestDriver {
+ public:
+  ParallelTestDriver(const Hands& hands, int trump, int num_threads)
+      : hands(hands), trump(trump) {
+    for (int i = 0; i < num_threads; ++i) workers.emplace_back(new Worker);
+  }
+
+  Bounds Search(int lead_seat, int num_tricks, int guess_tricks, Bounds known_bounds,
+                int* num_iterations, SearchBudget* budget = nullptr) {
+    for (auto& worker : workers) {
+      worker->min_max.reset(new MinMax(hands, trump, lead_seat, &worker->cutoffs));
+      worker->min_max->SetBudget(budget);
+    }
+    int upperbound = std::min<int>(num_tricks, known_bounds.upper);
+    int lowerbound = known_bounds.lower;
+    int ns_tricks = std::clamp(guess_tricks, lowerbound, upperbound);
+    common_bounds_cache.SetShared(true);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (lowerbound < upperbound) {
+      if (budget && budget->Expired()) break;
+      int first_beta = ns_tricks == lowerbound ? ns_tricks + 1 : ns_tricks;
+      for (int i = 0; i <= 2 * TOTAL_TRICKS; ++i) {
+        int beta = first_beta + (i % 2 ? (i + 1) / 2 : -i / 2);
+        if (beta <= lowerbound || beta > upperbound || Probing(beta)) continue;
+        auto idle = std::find_if(workers.begin(), workers.end(),
+                                 [](const auto& worker) { return !worker->running; });
+        if (idle == workers.end()) break;
+        Launch(idle->get(), beta);
+        if (num_iterations) ++*num_iterations;
+      }
+
+      finished_probe.wait(lock, [this] { return !finished.empty(); });
+      while (!finished.empty()) {
+        auto* worker = finished.back();
+        finished.pop_back();
+        worker->thread.join();
+        worker->running = false;
+        if (worker->min_max->Stopped()) continue;
+        ns_tricks = worker->ns_tricks;
+        if (ns_tricks < worker->beta)
+          upperbound = std::min(upperbound, ns_tricks);
+        else
+          lowerbound = std::max(lowerbound, ns_tricks);
+        if (budget && num_iterations)
+          budget->Update(*num_iterations, {char(lowerbound), char(upperbound)});
+        if (options.displaying_depth > 0)
+          printf("Lowerbound: %d\tUpperbound: %d\n", lowerbound, upperbound);
+      }
+      for (auto& worker : workers)
+        if (worker->running && (worker->beta <= lowerbound || worker->beta > upperbound))
+          worker->min_max->Stop();
+    }
+    for (auto& worker : workers)
+      if (worker->running) worker->min_max->Stop();
+    for (auto& worker : workers)
+      if (worker->running) {
+        finished_probe.wait(lock, [&worker] { return worker->done; });
+        worker->thread.join();
+        worker->running = false;
+      }
+    finished.clear();
+    common_bounds_cache.SetShared(false);
+    return {char(lowerbound), char(upperbound)};
+  }
+
+  // Like the cut-off cache of a single-threaded search after each lead.
+  void CarryCutoffs(bool reset) {
+    for (auto& worker : workers) {
+      if (reset) worker->cutoffs.Reset();
+      else worker->cutoffs.CarryOrReset();
+    }
+  }
+
+ private:
+  struct Worker {
+    Cache<CutoffEntry> cutoffs{"Cut-off Cache", 16};
+    std::unique_ptr<MinMax> min_max;
+    std::thread thread;
+    bool running = false;
+    bool done = false;
+    int beta = 0;
+    int ns_tricks = 0;
+  };
+
+  bool Probing(int beta) const {
+    for (const auto& worker : workers)
+      if (worker->running && worker->beta == beta) return true;
+    return false;
+  }
+
+  void Launch(Worker* worker, int beta) {
+    worker->running = true;
+    worker->done = false;
+    worker->beta = beta;
+    worker->min_max->Resume();
+    worker->thread = std::thread([this, worker] {
+      int ns_tricks = worker->min_max->Search(worker->beta);
+      std::lock_guard<std::mutex> lock(mutex);
+      worker->ns_tricks = ns_tricks;
+      worker->done = true;
+      finished.push_back(worker);
+      finished_probe.notify_one();
+    });
+  }
+
+  const Hands hands;
+  const int trump;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::mutex mutex;
+  std::condition_variable finished_probe;
+  std::vector<Worker*> finished;
+};
+#endif  // _WEB
+
 int GuessTricks(const Hands& hands, int trump) {
   if (options.guess_tricks >= 0) return std::min(options.guess_tricks, hands.num_tricks());
 
@@ -1939,35 +3184,404 @@ int GuessTricks(const Hands& hands, int trump) {
   return hands.num_tricks();
 }
 
+// Predicts the seconds to solve all strains and leads of a deal, so that a
+// batch can start its slowest deals first. It mostly scales with the nodes to
+// solve the deal cut down to the top nine cards of each hand. Wide static
+// bounds, voids and hands of the same shape, as in the symmetric deals, add
+// to it. The weights are fitted to the log of the single-core times of the
+// deals in *_deals/.
+double EstimateSolveTime(const Hands& hands) {
+  const int probe_tricks = 9;
+  Hands probe_hands = hands;
+  for (int seat = 0; seat < NUM_SEATS; ++seat) {
+    // Drop the lowest card, from the longest suit among equals.
+    auto& hand = probe_hands[seat];
+    while (hand.Size() > probe_tricks) {
+      int lowest = hand.Bottom();
+      for (int card : hand)
+        if (RankOf(card) < RankOf(lowest) ||
+            (RankOf(card) == RankOf(lowest) &&
+             hand.Suit(SuitOf(card)).Size() > hand.Suit(SuitOf(lowest)).Size()))
+          lowest = card;
+      hand.Remove(lowest);
+    }
+  }
+
+  long long probe_nodes = 0;
+  int bounds_width = 0;
+  for (int trump = 0; trump <= NOTRUMP; ++trump) {
+    for (int lead_seat = 0; lead_seat < NUM_SEATS; ++lead_seat) {
+      auto bounds = MinMax(hands, trump, lead_seat).StaticBounds();
+      bounds_width += bounds.upper - bounds.lower;
+
+      SearchBudget budget(0, 0, nullptr, trump, lead_seat);
+      MinMax min_max(probe_hands, trump, lead_seat);
+      min_max.SetBudget(&budget);
+      auto search = [&min_max](int beta) { return min_max.Search(beta); };
+      MemoryEnhancedTestDriver(search, probe_hands.num_tricks(), GuessTricks(probe_hands, trump),
+                               min_max.StaticBounds(), &budget);
+      probe_nodes += min_max.nodes_searched();
+    }
+    common_bounds_cache.Reset();
+    cutoff_cache.Reset();
+  }
+
+  int shape[NUM_SEATS][NUM_SUITS];
+  for (int seat = 0; seat < NUM_SEATS; ++seat) {
+    for (int suit = 0; suit < NUM_SUITS; ++suit) shape[seat][suit] = hands[seat].Suit(suit).Size();
+    std::sort(shape[seat], shape[seat] + NUM_SUITS);
+  }
+  int same_shapes = 0;
+  for (int seat = 0; seat < NUM_SEATS; ++seat)
+    for (int other = seat + 1; other < NUM_SEATS; ++other)
+      same_shapes += std::equal(shape[seat], shape[seat] + NUM_SUITS, shape[other]);
+
+  return exp(-12.83 + 0.778 * log(std::max(probe_nodes, 1LL)) + 0.0148 * bounds_width +
+             0.316 * hands.num_voids() + 0.063 * same_shapes);
+}
+
+// Results of full deals in their canonical forms, one line per solved cell:
+//   <canonical code> <trump> <lead seat> <NS tricks>
+// so a deal, or any deal equivalent to it, is never solved twice.
+class ResultsStore {
+ public:
+  ~ResultsStore() {
+    if (file) fclose(file);
+  }
+
+  void Open(const char* file_name) {
+    file = fopen(file_name, "a+t");
+    if (!file) {
+      fprintf(stderr, "Can't open results store: '%s'.\n", file_name);
+      exit(-1);
+    }
+    rewind(file);
+    char code[64], trump, lead_seat;
+    int ns_tricks;
+    while (fscanf(file, " %63s %c %c %d", code, &trump, &lead_seat, &ns_tricks) == 4)
+      results[Key(code, CharToSuit(trump), CharToSeat(lead_seat))] = ns_tricks;
+  }
+
+  bool IsOpen() const { return file != nullptr; }
+
+  int Lookup(const CanonicalDeal& deal, int trump, int lead_seat) const {
+    auto it = results.find(Key(deal, trump, lead_seat));
+    return it == results.end() ? -1 : deal.NsTricks(it->second);
+  }
+
+  void Save(const CanonicalDeal& deal, int trump, int lead_seat, int ns_tricks) {
+    auto key = Key(deal, trump, lead_seat);
+    results[key] = deal.NsTricks(ns_tricks);
+    fprintf(file, "%s %d\n", key.c_str(), results[key]);
+    fflush(file);
+  }
+
+ private:
+  static std::string Key(const std::string& code, int trump, int lead_seat) {
+    return code + ' ' + SuitName(trump)[0] + ' ' + SeatLetter(lead_seat);
+  }
+
+  static std::string Key(const CanonicalDeal& deal, int trump, int lead_seat) {
+    return Key(deal.canonical_hands().Code(), deal.Trump(trump), deal.Seat(lead_seat));
+  }
+
+  FILE* file = nullptr;
+  std::map<std::string, int> results;
+} results_store;
+
+// With keep_caches, the caches of the last strain are left for the caller to
+// search it again.
 void Solve(const Hands& hands, const std::vector<int>& trumps,
            const std::vector<int>& lead_seats,
            const std::function<void(int trump)>& trump_start,
-           const std::function<void(int trump, int lead_seat, int ns_tricks)>& seat_done,
-           const std::function<void(int trump)>& trump_done) {
+           const std::function<void(int trump, int lead_seat, Bounds ns_bounds)>& seat_done,
+           const std::function<void(int trump)>& trump_done, SolveMonitor* monitor = nullptr,
+           bool keep_caches = false) {
   int num_tricks = hands[WEST].Size();
+  double deal_deadline = options.deal_time_limit > 0 ? Now() + options.deal_time_limit : 0;
+  // Discarding suit bottoms may miss tricks, so the store keeps exact results only.
+  bool use_store =
+      results_store.IsOpen() && num_tricks == TOTAL_TRICKS && !options.discard_suit_bottom;
+  std::unique_ptr<CanonicalDeal> canonical_deal(use_store ? new CanonicalDeal(hands) : nullptr);
   for (int trump : trumps) {
     trump_start(trump);
     int guess_tricks = GuessTricks(hands, trump);
+#ifndef _WEB
+    std::unique_ptr<ParallelTestDriver> parallel_driver;
+#endif
     for (int lead_seat : lead_seats) {
+      if (use_store) {
+        int ns_tricks = results_store.Lookup(*canonical_deal, trump, lead_seat);
+        if (ns_tricks >= 0) {
+          guess_tricks = std::min(ns_tricks + 1, TOTAL_TRICKS);
+          seat_done(trump, lead_seat, {char(ns_tricks), char(ns_tricks)});
+          continue;
+        }
+      }
+      double deadline = options.cell_time_limit > 0 ? Now() + options.cell_time_limit : 0;
+      if (deal_deadline > 0 && (deadline == 0 || deal_deadline < deadline))
+        deadline = deal_deadline;
+      SearchBudget budget(deadline, options.cell_node_limit, monitor, trump, lead_seat);
+      auto* cell_budget =
+          deadline > 0 || options.cell_node_limit > 0 || monitor ? &budget : nullptr;
       MinMax min_max(hands, trump, lead_seat);
-      auto search = [&min_max](int beta) { return min_max.Search(beta); };
-      int ns_tricks = MemoryEnhancedTestDriver(search, num_tricks, guess_tricks);
-      guess_tricks = std::min(ns_tricks + 1, TOTAL_TRICKS);
+      min_max.SetBudget(cell_budget);
+      int num_iterations = 0;
+      auto search = [&min_max, &num_iterations](int beta) {
+        ++num_iterations;
+        return min_max.Search(beta);
+      };
+      auto bounds = min_max.StaticBounds();
+#ifndef _WEB
+      if (options.num_threads > 1 && !parallel_driver)
+        parallel_driver.reset(new ParallelTestDriver(hands, trump, options.num_threads));
+      auto ns_bounds = parallel_driver
+          ? parallel_driver->Search(lead_seat, num_tricks, guess_tricks, bounds, &num_iterations,
+                                    cell_budget)
+          : MemoryEnhancedTestDriver(search, num_tricks, guess_tricks, bounds, cell_budget);
+#else
+      auto ns_bounds =
+          MemoryEnhancedTestDriver(search, num_tricks, guess_tricks, bounds, cell_budget);
+#endif
+      bool solved = ns_bounds.lower == ns_bounds.upper;
+      guess_tricks = std::min(ns_bounds.lower + 1, TOTAL_TRICKS);
       if (options.stats_level) {
+        printf("--- MTD(f) ---\nbounds: %d-%d   iterations: %d\n", bounds.lower, bounds.upper,
+               num_iterations);
         common_bounds_cache.ShowStatistics();
+        if (options.trick_cache_tricks) trick_bounds_cache.ShowStatistics();
         cutoff_cache.ShowStatistics();
         VectorPool<Pattern>::ShowStatistics();
       }
-      seat_done(trump, lead_seat, ns_tricks);
+      if (use_store && solved)
+        results_store.Save(*canonical_deal, trump, lead_seat, ns_bounds.lower);
+      seat_done(trump, lead_seat, ns_bounds);
+      // Carried entries pay off even when few are reused (see -S), except the
+      // cut-off cards of voidy deals.
       if (hands.num_voids() >= 4) cutoff_cache.Reset();
+      else cutoff_cache.CarryOrReset();
+#ifndef _WEB
+      if (parallel_driver) parallel_driver->CarryCutoffs(hands.num_voids() >= 4);
+#endif
       if (hands.num_voids() >= 8) common_bounds_cache.Reset();
+      else common_bounds_cache.CarryOrReset();
+    }
+    if (!keep_caches || trump != trumps.back()) {
+      common_bounds_cache.Reset();
+      cutoff_cache.Reset();
     }
-    common_bounds_cache.Reset();
-    cutoff_cache.Reset();
     trump_done(trump);
   }
+#ifdef _PROFILE
+  Profiler::Show();
+#endif
 }
 
+// Par is the outcome of a game over the bidding ladder. After a side bids a
+// contract, the other side either passes, doubling the contract if it goes
+// down, or bids higher. The dealer's side gets the first chance to bid. The
+// tricks of each side in each strain are bounded by null-window probes only
+// as far as the par score needs them.
+class ParSolver {
+ public:
+  enum { NS, EW, NUM_SIDES };
+  static constexpr int NUM_STRAINS = NUM_SUITS + 1;
+  static constexpr int NUM_CONTRACTS = 7 * NUM_STRAINS;
+
+  struct Contract {
+    int level;
+    int strain;
+    int side;
+    int tricks;
+    bool doubled;
+  };
+
+  struct Outcome {
+    int ns_score = 0;
+    std::vector<Contract> contracts;  // Empty if passed out
+  };
+
+  ParSolver(const Hands& hands, int dealer, const bool vulnerable[NUM_SIDES])
+      : hands(hands), dealer_side(IsNs(dealer) ? NS : EW) {
+    for (int side = NS; side < NUM_SIDES; ++side) this->vulnerable[side] = vulnerable[side];
+    for (int strain = 0; strain < NUM_STRAINS; ++strain)
+      for (int seat = 0; seat < NUM_SEATS; ++seat)
+        cells[strain][seat] = MinMax(hands, strain, seat).StaticBounds();
+  }
+
+  Outcome Solve() {
+    int current_strain = -1;
+    while (true) {
+      auto low = Auction(Ends(false)), high = Auction(Ends(true));
+      if (low.ns_score == high.ns_score) {
+        common_bounds_cache.Reset();
+        cutoff_cache.Reset();
+        return low;
+      }
+      auto [side, strain, tricks] = PickProbe(current_strain);
+      if (strain != current_strain) {
+        common_bounds_cache.Reset();
+        cutoff_cache.Reset();
+        current_strain = strain;
+      }
+      Probe(side, strain, tricks);
+    }
+  }
+
+  int num_probes() const { return probes; }
+  int num_cells_probed() const { return cells_probed.size(); }
+
+  static int Score(const Contract& contract, bool vulnerable) {
+    int needed = contract.level + 6;
+    if (contract.tricks < needed) {
+      int down = needed - contract.tricks;
+      if (vulnerable) return -(300 * down - 100);
+      return -(down == 1 ? 100 : down == 2 ? 300 : 300 * down - 400);
+    }
+    bool minor = contract.strain == DIAMOND || contract.strain == CLUB;
+    int trick_points = minor ? 20 : 30;
+    int contract_points = contract.level * trick_points + (contract.strain == NOTRUMP ? 10 : 0);
+    int score = contract_points + (contract.tricks - needed) * trick_points;
+    score += contract_points >= 100 ? (vulnerable ? 500 : 300) : 50;
+    if (contract.level == 6) score += vulnerable ? 750 : 500;
+    if (contract.level == 7) score += vulnerable ? 1500 : 1000;
+    return score;
+  }
+
+ private:
+  typedef std::array<std::array<int, NUM_STRAINS>, NUM_SIDES> Tricks;
+
+  // Tricks of the better declarer of a side, from the NS tricks of the cells.
+  Bounds SideBounds(int side, int strain) const {
+    const auto* cell = cells[strain];
+    if (side == NS)
+      return {std::max(cell[WEST].lower, cell[EAST].lower),
+              std::max(cell[WEST].upper, cell[EAST].upper)};
+    return {char(TOTAL_TRICKS - std::min(cell[NORTH].upper, cell[SOUTH].upper)),
+            char(TOTAL_TRICKS - std::min(cell[NORTH].lower, cell[SOUTH].lower))};
+  }
+
+  // The ends of the bounds most and least favorable to NS.
+  Tricks Ends(bool ns_favored) const {
+    Tricks tricks;
+    for (int side = NS; side < NUM_SIDES; ++side)
+      for (int strain = 0; strain < NUM_STRAINS; ++strain) {
+        auto bounds = SideBounds(side, strain);
+        tricks[side][strain] = (side == NS) == ns_favored ? bounds.upper : bounds.lower;
+      }
+    return tricks;
+  }
+
+  // The range of par scores if the tricks of a side in a strain were within
+  // the given bounds.
+  int Width(int side, int strain, Bounds bounds) const {
+    auto low = Ends(false), high = Ends(true);
+    low[side][strain] = side == NS ? bounds.lower : bounds.upper;
+    high[side][strain] = side == NS ? bounds.upper : bounds.lower;
+    return Auction(high, false).ns_score - Auction(low, false).ns_score;
+  }
+
+  // Picks the side, strain and tricks to probe that narrow the range of par
+  // scores the most whichever way the probe goes. Probes in the current
+  // strain go first if they help at all, as they reuse the caches.
+  std::tuple<int, int, int> PickProbe(int current_strain) const {
+    int full_width = Auction(Ends(true), false).ns_score - Auction(Ends(false), false).ns_score;
+    std::tuple<int, int, int> best;
+    int best_gain = -1, best_span = -1;
+    for (int side = NS; side < NUM_SIDES; ++side)
+      for (int strain = 0; strain < NUM_STRAINS; ++strain) {
+        auto bounds = SideBounds(side, strain);
+        int span = bounds.upper - bounds.lower;
+        for (int tricks = bounds.lower + 1; tricks <= bounds.upper; ++tricks) {
+          int gain = full_width - std::max(Width(side, strain, {char(tricks), bounds.upper}),
+                                           Width(side, strain, {bounds.lower, char(tricks - 1)}));
+          if (strain == current_strain && gain > 0) gain += 1 << 16;
+          // Without any gain, the widest bounds are halved.
+          if (gain == 0 && tricks != (bounds.lower + bounds.upper + 1) / 2) continue;
+          if (gain > best_gain || (gain == best_gain && span > best_span)) {
+            best = {side, strain, tricks};
+            best_gain = gain;
+            best_span = span;
+          }
+        }
+      }
+    return best;
+  }
+
+  // Finds out whether a side takes at least the given tricks in a strain.
+  void Probe(int side, int strain, int tricks) {
+    auto leads = side == NS ? std::array<int, 2>{WEST, EAST} : std::array<int, 2>{NORTH, SOUTH};
+    for (int lead_seat : leads) {
+      auto& cell = cells[strain][lead_seat];
+      // NS tricks at or above beta mean the side reaches the tricks.
+      int beta = side == NS ? tricks : TOTAL_TRICKS - tricks + 1;
+      bool reached = side == NS ? cell.lower >= beta : cell.upper < beta;
+      if (reached) return;
+      if (cell.Cutoff(beta)) continue;
+      ++probes;
+      cells_probed.insert(strain * NUM_SEATS + lead_seat);
+      int ns_tricks = MinMax(hands, strain, lead_seat).Search(beta);
+      if (ns_tricks >= beta)
+        cell.lower = ns_tricks;
+      else
+        cell.upper = ns_tricks;
+      if ((ns_tricks >= beta) == (side == NS)) return;
+    }
+  }
+
+  Outcome Auction(const Tricks& tricks, bool with_contracts = true) const {
+    // outcomes[c][side] is the outcome after the side bids contract c.
+    std::array<std::array<Outcome, NUM_SIDES>, NUM_CONTRACTS> outcomes;
+    auto better = [](int side, const Outcome& a, const Outcome& b) {
+      return side == NS ? a.ns_score > b.ns_score : a.ns_score < b.ns_score;
+    };
+    // Keeps the best outcome for the side, gathering the contracts of ties
+    // unless a lower one of the same strain and side is there already.
+    auto choose = [&better](int side, Outcome* best, const Outcome& option) {
+      if (better(side, option, *best)) {
+        *best = option;
+      } else if (option.ns_score == best->ns_score) {
+        for (const auto& contract : option.contracts)
+          if (std::none_of(best->contracts.begin(), best->contracts.end(),
+                           [&contract](const Contract& c) {
+                             return c.strain == contract.strain && c.side == contract.side;
+                           }))
+            best->contracts.push_back(contract);
+      }
+    };
+    for (int c = NUM_CONTRACTS - 1; c >= 0; --c)
+      for (int side = NS; side < NUM_SIDES; ++side) {
+        int level = c / NUM_STRAINS + 1, strain = StrainOf(c % NUM_STRAINS);
+        Contract contract = {level, strain, side, tricks[side][strain], false};
+        contract.doubled = contract.tricks < level + 6;
+        int score = Score(contract, vulnerable[side]);
+        auto& outcome = outcomes[c][side];
+        outcome = {side == NS ? score : -score, {}};
+        if (with_contracts) outcome.contracts.push_back(contract);
+        for (int higher = c + 1; higher < NUM_CONTRACTS; ++higher)
+          choose(1 - side, &outcome, outcomes[higher][1 - side]);
+      }
+    Outcome second;
+    for (int c = 0; c < NUM_CONTRACTS; ++c)
+      choose(1 - dealer_side, &second, outcomes[c][1 - dealer_side]);
+    Outcome first = second;
+    for (int c = 0; c < NUM_CONTRACTS; ++c) choose(dealer_side, &first, outcomes[c][dealer_side]);
+    return first;
+  }
+
+  // Strains from the lowest in the bidding.
+  static int StrainOf(int order) {
+    return order == NUM_SUITS ? NOTRUMP : NUM_SUITS - 1 - order;
+  }
+
+  const Hands hands;
+  const int dealer_side;
+  bool vulnerable[NUM_SIDES];
+  Bounds cells[NUM_STRAINS][NUM_SEATS];  // NS tricks by strain and lead
+  int probes = 0;
+  std::set<int> cells_probed;
+};
+
 class InteractivePlay {
  public:
   InteractivePlay(const Hands& hands, int trump, int lead_seat, int target_ns_tricks)
@@ -2092,7 +3706,7 @@ class InteractivePlay {
         play.UnplayCard();
         return ns_tricks;
       };
-      int new_ns_tricks = MemoryEnhancedTestDriver(search, num_tricks, ns_tricks);
+      int new_ns_tricks = MemoryEnhancedTestDriver(search, num_tricks, ns_tricks).lower;
       card_tricks[card] = new_ns_tricks;
 
       int trick_diff = ns_contract ? new_ns_tricks - target_ns_tricks
@@ -2251,20 +3865,116 @@ class InteractivePlay {
   std::vector<PlayRecord> play_history;
 };
 
-#ifdef _WEB
+// Parses a play record like "CJCAC6C2" or the LIN form "pc|CJ|pc|CA|".
+std::vector<int> ParsePlays(const char* plays) {
+  std::vector<int> cards;
+  for (const char* c = plays; *c;) {
+    if (strchr("| ,", *c)) {
+      ++c;
+    } else if (tolower(c[0]) == 'p' && tolower(c[1]) == 'c') {
+      c += 2;
+    } else {
+      if (!c[1]) {
+        fprintf(stderr, "Incomplete card: %s\n", c);
+        exit(-1);
+      }
+      int suit = CharToSuit(c[0]);
+      int rank = CharToRank(c[1]);
+      if (suit == NOTRUMP) {
+        fprintf(stderr, "Unknown suit: %c\n", c[0]);
+        exit(-1);
+      }
+      cards.push_back(CardOf(suit, rank));
+      c += c[1] == '1' && c[2] == '0' ? 3 : 2;
+    }
+  }
+  return cards;
+}
+
+// Double-dummy analysis of a play record in one pass. The search walks down
+// the record with one MinMax, so the caches stay warm and the value after the
+// previous card is the guess for the next one.
+class PlayAnalysis {
+ public:
+  struct Record {
+    int seat;
+    int card;
+    int ns_tricks;  // NS tricks with optimal play after this card
+    int loss;       // Tricks lost by the player of this card
+  };
+
+  PlayAnalysis(const Hands& hands, int trump, int lead_seat)
+      : min_max(hands, trump, lead_seat), num_tricks(hands.num_tricks()) {}
+
+  int Analyze(const std::vector<int>& cards, std::vector<Record>* records) {
+    auto& root = min_max.play(0);
+    SetupPlay(root);
+    auto search = [&root](int beta) { return root.SearchWithCache(beta).first; };
+    int initial_ns_tricks =
+        MemoryEnhancedTestDriver(search, num_tricks, GuessTricks(root.hands, root.trump)).lower;
+
+    int ns_tricks = initial_ns_tricks, last_trick_ns_tricks = 0;
+    int last_trick = (num_tricks - 1) * 4;
+    for (int p = 0; p < std::min<int>(cards.size(), num_tricks * 4); ++p) {
+      auto& play = min_max.play(p);
+      if (p > 0) SetupPlay(play);
+      if (p == last_trick) last_trick_ns_tricks = play.CollectLastTrick().first;
+
+      int card = cards[p];
+      const Cards& hand = play.hands[play.seat_to_play];
+      if (!hand.Have(card) || (!play.TrickStarting() && SuitOf(card) != play.LeadSuit() &&
+                               hand.Suit(play.LeadSuit()))) {
+        fprintf(stderr, "%s can't play %s.\n", SeatName(play.seat_to_play), NameOf(card));
+        break;
+      }
+      play.PlayCard(card);
+
+      int new_ns_tricks = last_trick_ns_tricks;
+      if (p < last_trick) {
+        auto search = [&play](int beta) { return play.NextPlay().SearchWithCache(beta).first; };
+        new_ns_tricks = MemoryEnhancedTestDriver(search, num_tricks, ns_tricks).lower;
+      }
+      int loss = play.NsToPlay() ? ns_tricks - new_ns_tricks : new_ns_tricks - ns_tricks;
+      records->push_back({play.seat_to_play, card, new_ns_tricks, loss});
+      ns_tricks = new_ns_tricks;
+    }
+    return initial_ns_tricks;
+  }
+
+ private:
+  void SetupPlay(Play& play) const {
+    if (play.TrickStarting()) {
+      if (play.depth > 0) {
+        play.ns_tricks_won = play.PreviousPlay().ns_tricks_won + play.PreviousPlay().NsWon();
+        play.seat_to_play = play.PreviousPlay().WinningSeat();
+      }
+      play.trick->all_cards = play.hands.all_cards();
+      play.ComputeShape();
+      play.trick->ComputeRelativeHands(play.depth, play.hands);
+    } else {
+      play.ns_tricks_won = play.PreviousPlay().ns_tricks_won;
+      play.seat_to_play = play.PreviousPlay().NextSeat();
+    }
+  }
+
+  MinMax min_max;
+  const int num_tricks;
+};
+
 class WebPlay {
  public:
   WebPlay(const Hands& hands, int trump, int lead_seat, int target_ns_tricks,
-          std::vector<int> played_cards)
-      : min_max(hands, trump, lead_seat),
+          std::vector<int> played_cards, Cache<CutoffEntry>* cutoffs = &cutoff_cache)
+      : min_max(hands, trump, lead_seat, cutoffs),
         target_ns_tricks(target_ns_tricks),
         num_tricks(hands.num_tricks()),
         played_cards(played_cards){}
 
   typedef std::map<int, int> CardTricks;
 
-  CardTricks EvaluateLeads(int ns_tricks, bool ns_contract) {
-    // Play all the cards from start.
+  // Plays all the cards from start. Returns the play after them, or nullptr
+  // if one of them can't be played.
+  Play* Replay() {
     for (size_t p = 0; p <= played_cards.size(); ++p) {
       auto& play = min_max.play(p);
       if (play.TrickStarting()) {
@@ -2281,11 +3991,21 @@ class WebPlay {
         play.seat_to_play = play.PreviousPlay().NextSeat();
       }
       // Leave the last trick for GetPlayableCards() below.
-      if (p < played_cards.size() && p < TOTAL_CARDS - 4)
+      if (p < played_cards.size() && p < TOTAL_CARDS - 4) {
+        if (!play.GetPlayableCards().Have(played_cards[p])) return nullptr;
         play.PlayCard(played_cards[p]);
+      }
     }
+    return &min_max.play(played_cards.size());
+  }
+
+  // The seat that plays the p-th card, after Replay().
+  int SeatOf(size_t p) { return min_max.play(p).seat_to_play; }
 
-    auto& play = min_max.play(played_cards.size());
+  CardTricks EvaluateLeads(int ns_tricks, bool ns_contract) {
+    auto* replayed = Replay();
+    if (!replayed) return {};
+    auto& play = *replayed;
     CardTricks card_tricks;
     if (played_cards.size() >= TOTAL_CARDS - 4) {
       // The last trick.
@@ -2302,7 +4022,7 @@ class WebPlay {
         play.UnplayCard();
         return ns_tricks;
       };
-      int new_ns_tricks = MemoryEnhancedTestDriver(search, num_tricks, ns_tricks);
+      int new_ns_tricks = MemoryEnhancedTestDriver(search, num_tricks, ns_tricks).lower;
       int trick_diff = ns_contract ? new_ns_tricks - target_ns_tricks
         : target_ns_tricks - new_ns_tricks;
       card_tricks[card] = trick_diff;
@@ -2317,6 +4037,201 @@ class WebPlay {
   const std::vector<int> played_cards;
 };
 
+#ifndef _WEB
+// Single-dummy evaluation of the cards playable after some plays. The hands
+// hidden from the player are dealt at random from the unseen cards, keeping
+// the voids shown by the plays, and every card is scored double-dummy in each
+// layout. Sampling stops once the best card beats the runner-up by two
+// standard errors of their paired difference, or after max_samples layouts.
+class SingleDummy {
+ public:
+  struct CardScore {
+    int card;
+    double tricks;  // Mean tricks of the side to play
+    double error;   // Standard error of the mean
+  };
+
+  SingleDummy(const Hands& hands, int trump, int lead_seat, const std::vector<int>& played_cards)
+      : trump(trump), lead_seat(lead_seat), played_cards(played_cards) {
+    WebPlay web_play(hands, trump, lead_seat, 0, played_cards);
+    auto* play = web_play.Replay();
+    if (!play) return;
+    for (size_t p = 0; p < played_cards.size(); ++p) {
+      int seat = web_play.SeatOf(p), card = played_cards[p];
+      if (!hands[seat].Have(card) || played_by[seat].Have(card)) return;
+      played_by[seat].Add(card);
+      int lead_suit = SuitOf(played_cards[p - p % 4]);
+      if (SuitOf(card) != lead_suit) voids[seat] |= 1 << lead_suit;
+    }
+    seat_to_play = web_play.SeatOf(played_cards.size());
+    for (int seat = 0; seat < NUM_SEATS; ++seat)
+      remaining[seat] = hands[seat].Different(played_by[seat]);
+    candidates = played_cards.size() < TOTAL_CARDS - 4 ? play->GetPlayableCards()
+                                                       : remaining[seat_to_play];
+
+    // Defenders see the dummy after the opening lead, and the declarer plays
+    // for both.
+    int declarer = (lead_seat + 3) % NUM_SEATS, dummy = (lead_seat + 1) % NUM_SEATS;
+    for (int seat = 0; seat < NUM_SEATS; ++seat) {
+      bool visible = seat == seat_to_play || (seat == dummy && !played_cards.empty()) ||
+                     (seat == declarer && seat_to_play == dummy);
+      if (!visible) hidden_seats.push_back(seat);
+    }
+    for (int seat : hidden_seats) unseen.Add(remaining[seat]);
+
+    // Cards in sequence with only known cards of the player or played cards
+    // between them are the same choice.
+    Cards known = remaining[seat_to_play];
+    for (int card : played_cards) known.Add(card);
+    int prev_card = -1;
+    for (int card : candidates) {
+      bool same = prev_card >= 0 && SuitOf(prev_card) == SuitOf(card);
+      for (int between = prev_card + 1; same && between < card; ++between)
+        same = known.Have(between);
+      choices.push_back(same ? choices.back() : card);
+      prev_card = card;
+    }
+  }
+
+  bool Legal() const { return bool(candidates); }
+  int SeatToPlay() const { return seat_to_play; }
+  int NumSamples() const { return scores.size(); }
+
+  // Scores the candidates, best first.
+  std::vector<CardScore> Evaluate(int max_samples, int num_threads) {
+    std::vector<int> cards;
+    for (int card : candidates) cards.push_back(card);
+    if (cards.size() > 1) {
+      uint64_t seed = SharedRandom()();
+      common_bounds_cache.SetShared(num_threads > 1);
+      std::vector<std::thread> threads;
+      for (int i = 1; i < num_threads; ++i)
+        threads.emplace_back([this, &cards, max_samples, seed] {
+          Cache<CutoffEntry> cutoffs("Cut-off Cache", 16);
+          Sample(cards, max_samples, seed, &cutoffs);
+        });
+      Sample(cards, max_samples, seed, &cutoff_cache);
+      for (auto& thread : threads) thread.join();
+      common_bounds_cache.SetShared(false);
+      common_bounds_cache.Reset();
+      cutoff_cache.Reset();
+    }
+
+    std::vector<CardScore> card_scores;
+    for (size_t c = 0; c < cards.size(); ++c) {
+      auto [mean, error] = Statistics([c](const std::vector<int>& s) { return s[c]; });
+      card_scores.push_back({cards[c], mean, error});
+    }
+    std::stable_sort(card_scores.begin(), card_scores.end(),
+                     [](const CardScore& a, const CardScore& b) { return a.tricks > b.tricks; });
+    return card_scores;
+  }
+
+ private:
+  void Sample(const std::vector<int>& cards, int max_samples, uint64_t seed,
+              Cache<CutoffEntry>* cutoffs) {
+    int guess_tricks = -1;
+    for (int i; !settled && (i = next_sample++) < max_samples;) {
+      // Each layout has its own seed, so it does not depend on the threads.
+      Random random(seed, i);
+      auto hands = DealHidden(random);
+      if (guess_tricks < 0) guess_tricks = GuessTricks(hands, trump);
+      // With no target, the differences are plain NS tricks.
+      auto card_tricks = WebPlay(hands, trump, lead_seat, 0, played_cards, cutoffs)
+                             .EvaluateLeads(guess_tricks, true);
+      guess_tricks = card_tricks.begin()->second;
+      // A card skipped as equivalent scores the same as the next higher one.
+      std::vector<int> ns_tricks(cards.size()), tricks(cards.size());
+      for (size_t c = 0; c < cards.size(); ++c) {
+        auto it = card_tricks.find(cards[c]);
+        ns_tricks[c] = it != card_tricks.end() ? it->second : ns_tricks[c - 1];
+        tricks[c] = IsNs(seat_to_play) ? ns_tricks[c] : hands.num_tricks() - ns_tricks[c];
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      scores.push_back(std::move(tricks));
+      if (Settled()) settled = true;
+    }
+  }
+
+  // Cards of a suit that a hidden seat has shown out of must go to the other
+  // one. The rest are shuffled into the room left.
+  Hands DealHidden(Random& random) const {
+    Hands hands;
+    for (int seat = 0; seat < NUM_SEATS; ++seat) hands[seat] = played_by[seat];
+    std::vector<int> free_cards;
+    for (int card : unseen) {
+      std::vector<int> seats;
+      for (int seat : hidden_seats)
+        if (!(voids[seat] & (1 << SuitOf(card)))) seats.push_back(seat);
+      if (seats.size() == 1)
+        hands[seats[0]].Add(card);
+      else
+        free_cards.push_back(card);
+    }
+    std::shuffle(free_cards.begin(), free_cards.end(), random);
+    for (int seat = 0; seat < NUM_SEATS; ++seat) {
+      if (std::find(hidden_seats.begin(), hidden_seats.end(), seat) == hidden_seats.end()) {
+        hands[seat].Add(remaining[seat]);
+        continue;
+      }
+      while (hands[seat].Size() < played_by[seat].Size() + remaining[seat].Size()) {
+        hands[seat].Add(free_cards.back());
+        free_cards.pop_back();
+      }
+    }
+    return hands;
+  }
+
+  // The mean and its standard error over the layouts.
+  std::pair<double, double> Statistics(
+      const std::function<double(const std::vector<int>&)>& value) const {
+    double sum = 0, sum2 = 0;
+    for (const auto& s : scores) {
+      sum += value(s);
+      sum2 += value(s) * value(s);
+    }
+    int n = scores.size();
+    double mean = n ? sum / n : 0;
+    double variance = n > 1 ? std::max(0.0, (sum2 - n * mean * mean) / (n - 1)) : 0;
+    return {mean, n ? sqrt(variance / n) : 0};
+  }
+
+  bool Settled() const {
+    constexpr int kMinSamples = 16;
+    if (scores.size() < kMinSamples || scores[0].size() < 2) return false;
+    std::vector<double> means(scores[0].size());
+    for (size_t c = 0; c < means.size(); ++c)
+      means[c] = Statistics([c](const std::vector<int>& s) { return s[c]; }).first;
+    size_t best = std::max_element(means.begin(), means.end()) - means.begin();
+    size_t second = best;
+    for (size_t c = 0; c < means.size(); ++c)
+      if (choices[c] != choices[best] && (second == best || means[c] > means[second])) second = c;
+    if (second == best) return true;
+    auto [mean, error] =
+        Statistics([best, second](const std::vector<int>& s) { return s[best] - s[second]; });
+    return mean > 2 * error;
+  }
+
+  const int trump;
+  const int lead_seat;
+  const std::vector<int> played_cards;
+  int seat_to_play = 0;
+  Cards played_by[NUM_SEATS];
+  Cards remaining[NUM_SEATS];
+  int voids[NUM_SEATS] = {0};
+  Cards candidates;
+  std::vector<int> choices;  // The highest card of each candidate's sequence
+  Cards unseen;
+  std::vector<int> hidden_seats;
+
+  std::atomic<int> next_sample{0};
+  std::atomic<bool> settled{false};
+  std::mutex mutex;
+  std::vector<std::vector<int>> scores;  // Tricks of each candidate in each layout
+};
+#endif  // _WEB
+
+#ifdef _WEB
 Hands CollectHands(const char* west, const char* north,
                    const char* east, const char* south) {
   Cards all_cards;
@@ -2339,9 +4254,9 @@ std::string solve(std::string west, std::string north,
   auto trump_start = [&](int trump) {
     sprintf(buffer + strlen(buffer), "%c", SuitName(trump)[0]);
   };
-  auto seat_done = [&](int trump, int lead_seat, int ns_tricks) {
+  auto seat_done = [&](int trump, int lead_seat, Bounds ns_bounds) {
     sprintf(buffer + strlen(buffer), " %2d",
-            IsNs(lead_seat) ? hands.num_tricks() - ns_tricks : ns_tricks);
+            IsNs(lead_seat) ? hands.num_tricks() - ns_bounds.lower : ns_bounds.lower);
   };
   auto trump_done = [start_time](int trump) {
     sprintf(buffer + strlen(buffer), " %5.2f s\n", Now() - start_time);
@@ -2385,6 +4300,30 @@ std::string solve_plays(std::string west, std::string north,
   return buffer;
 }
 
+std::string analyze_plays(std::string west, std::string north,
+                          std::string east, std::string south,
+                          int trump, int lead_seat, std::string played_cards) {
+  auto hands = CollectHands(west.c_str(), north.c_str(),
+                            east.c_str(), south.c_str());
+  std::vector<PlayAnalysis::Record> records;
+  int ns_tricks = PlayAnalysis(hands, trump, lead_seat)
+                      .Analyze(ParsePlays(played_cards.c_str()), &records);
+
+  // Each card is followed by NS tricks after it and tricks lost by it.
+  std::string buffer = std::to_string(ns_tricks);
+  for (const auto& record : records) {
+    char card_result[16];
+    snprintf(card_result, sizeof(card_result), " %s:%d:%d", NameOf(record.card),
+             record.ns_tricks, record.loss);
+    buffer += card_result;
+  }
+
+  common_bounds_cache.Reset();
+  cutoff_cache.Reset();
+
+  return buffer;
+}
+
 #ifndef _TEST
 #include <emscripten/bind.h>
 
@@ -2393,38 +4332,339 @@ using namespace emscripten;
 EMSCRIPTEN_BINDINGS(my_module) {
   function("solve", &solve);
   function("solve_plays", &solve_plays);
+  function("analyze_plays", &analyze_plays);
 }
 #endif // !_TEST
 #else  // _WEB
-int main(int argc, char* argv[]) {
-  options.Read(argc, argv);
+// A request is a flat JSON object on one line. Values are kept as raw JSON
+// text, so an id is echoed back as it was given.
+class Request {
+ public:
+  bool Parse(const char* c) {
+    auto skip = [&c] {
+      while (isspace(*c)) ++c;
+    };
+    auto scan_string = [&c] {
+      const char* start = c++;
+      while (*c && *c != '"') c += c[0] == '\\' && c[1] ? 2 : 1;
+      if (!*c) return std::string();
+      return std::string(start, ++c);
+    };
+    skip();
+    if (*c++ != '{') return false;
+    skip();
+    if (*c == '}') return true;
+    while (true) {
+      skip();
+      if (*c != '"') return false;
+      auto key = scan_string();
+      if (key.empty()) return false;
+      skip();
+      if (*c++ != ':') return false;
+      skip();
+      std::string value;
+      if (*c == '"') {
+        value = scan_string();
+      } else {
+        const char* start = c;
+        while (*c && *c != ',' && *c != '}' && !isspace(*c)) ++c;
+        value.assign(start, c);
+      }
+      if (value.empty()) return false;
+      fields[key.substr(1, key.size() - 2)] = value;
+      skip();
+      if (*c == '}') return true;
+      if (*c++ != ',') return false;
+    }
+  }
+
+  bool Has(const char* key) const { return fields.count(key); }
+  std::string Raw(const char* key) const { return Has(key) ? fields.at(key) : "null"; }
+  std::string String(const char* key) const {
+    if (!Has(key)) return "";
+    const auto& value = fields.at(key);
+    return value[0] == '"' ? value.substr(1, value.size() - 2) : value;
+  }
+
+ private:
+  std::map<std::string, std::string> fields;
+};
 
+// A worker keeps its caches for the next request on the same deal and strain,
+// which searches many of the same positions again. Bounds hold in a strain
+// whatever the deal, but other deals share few positions.
+class WarmCaches {
+ public:
+  // Gets the caches ready to search the deal in the strain.
+  void Begin(const std::string& code, int trump) {
+    if (code != warm_code || trump != warm_trump) Clear();
+    // A request failing before End() leaves them cold.
+    warm_code.clear();
+  }
+
+  // Keeps the caches after searching the deal in the strain.
+  void End(const std::string& code, int trump) {
+    common_bounds_cache.CarryOrReset();
+    cutoff_cache.CarryOrReset();
+    warm_code = code;
+    warm_trump = trump;
+  }
+
+  void Clear() {
+    common_bounds_cache.Reset();
+    cutoff_cache.Reset();
+    warm_code.clear();
+  }
+
+ private:
+  std::string warm_code;
+  int warm_trump = -1;
+} warm_caches;
+
+// Answers a request with lines of JSON carrying its id. The last line has
+// "done": true.
+void Answer(const char* line, FILE* out) {
+  Request request;
+  bool parsed = request.Parse(line);
+  auto id = request.Raw("id");
+  auto fail = [&](const char* error) {
+    fprintf(out, "{\"id\": %s, \"error\": \"%s\", \"done\": true}\n", id.c_str(), error);
+  };
+  if (!parsed) return fail("malformed request");
+  auto type = request.String("type");
+  if (type != "table" && type != "target" && type != "cards" && type != "single_dummy")
+    return fail("unknown type");
+  auto code = request.String("code");
   Hands hands;
+  if (!hands.Decode(code.c_str())) return fail("invalid code");
+
   std::vector<int> trumps = {NOTRUMP, SPADE, HEART, DIAMOND, CLUB};
   std::vector<int> lead_seats = {WEST, EAST, NORTH, SOUTH};
-  if (options.code)
-    hands.Decode(options.code);
-  else if (options.input_file)
-    ReadHands(hands, trumps, lead_seats);
-  else if (options.randomize)
-    hands.Randomize();
-  else
-    options.ShowUsage(argv[0]);
-  if (options.shuffle_seats) hands.Shuffle(options.shuffle_seats);
+  auto trump = request.String("trump"), lead = request.String("lead");
+  if (!trump.empty()) {
+    if (trump.size() != 1 || !strchr("NSHDCnshdc", trump[0])) return fail("invalid trump");
+    trumps = {CharToSuit(trump[0])};
+  }
+  if (!lead.empty()) {
+    if (lead.size() != 1 || !strchr("WNESwnes", lead[0])) return fail("invalid lead");
+    lead_seats = {CharToSeat(lead[0])};
+  }
+
+  auto start_time = Now();
+  if (type == "table") {
+    auto seat_done = [&](int trump, int lead_seat, Bounds ns_bounds) {
+      fprintf(out, "{\"id\": %s, \"trump\": \"%c\", \"lead\": \"%c\", ", id.c_str(),
+              SuitName(trump)[0], SeatLetter(lead_seat));
+      if (ns_bounds.lower == ns_bounds.upper)
+        fprintf(out, "\"ns_tricks\": %d}\n", ns_bounds.lower);
+      else
+        fprintf(out, "\"ns_bounds\": [%d, %d]}\n", ns_bounds.lower, ns_bounds.upper);
+      fflush(out);
+    };
+    auto do_nothing = [](int trump) {};
+    warm_caches.Begin(code, trumps[0]);
+    Solve(hands, trumps, lead_seats, do_nothing, seat_done, do_nothing, nullptr, true);
+    warm_caches.End(code, trumps.back());
+    fprintf(out, "{\"id\": %s, \"done\": true, \"time\": %.3f}\n", id.c_str(),
+            Now() - start_time);
+    return;
+  }
+
+  if (trumps.size() != 1 || lead_seats.size() != 1) return fail("trump and lead required");
+  if (type == "target") {
+    int target = atoi(request.String("target").c_str());
+    if (!request.Has("target") || target < 0 || target > TOTAL_TRICKS)
+      return fail("invalid target");
+    warm_caches.Begin(code, trumps[0]);
+    bool made = MinMax(hands, trumps[0], lead_seats[0]).Search(target) >= target;
+    warm_caches.End(code, trumps[0]);
+    fprintf(out, "{\"id\": %s, \"made\": %s, \"done\": true, \"time\": %.3f}\n", id.c_str(),
+            made ? "true" : "false", Now() - start_time);
+    return;
+  }
+
+  auto plays = request.String("plays");
+  std::vector<int> cards;
+  for (size_t i = 0; i + 1 < plays.size(); i += 2) {
+    if (!strchr("SHDCshdc", plays[i]) || !strchr("AKQJT98765432akqjt", plays[i + 1]))
+      return fail("invalid plays");
+    cards.push_back(CardOf(CharToSuit(plays[i]), CharToRank(plays[i + 1])));
+  }
+  if (plays.size() % 2 || cards.size() >= TOTAL_CARDS) return fail("invalid plays");
+  if (type == "cards") {
+    // A target of zero NS tricks makes the trick differences plain NS tricks.
+    warm_caches.Begin(code, trumps[0]);
+    auto card_tricks = WebPlay(hands, trumps[0], lead_seats[0], 0, cards)
+                           .EvaluateLeads(GuessTricks(hands, trumps[0]), true);
+    warm_caches.End(code, trumps[0]);
+    if (card_tricks.empty()) return fail("illegal play");
+    fprintf(out, "{\"id\": %s, \"ns_tricks\": {", id.c_str());
+    for (const auto& [card, ns_tricks] : card_tricks)
+      fprintf(out, "%s\"%s\": %d", card == card_tricks.begin()->first ? "" : ", ", NameOf(card),
+              ns_tricks);
+    fprintf(out, "}, \"done\": true, \"time\": %.3f}\n", Now() - start_time);
+  } else {
+    // The layouts are other deals.
+    warm_caches.Clear();
+    SingleDummy single_dummy(hands, trumps[0], lead_seats[0], cards);
+    if (!single_dummy.Legal()) return fail("illegal play");
+    int max_samples = request.Has("layouts") ? atoi(request.String("layouts").c_str()) : 100;
+    auto card_scores = single_dummy.Evaluate(std::max(1, max_samples), options.num_threads);
+    fprintf(out, "{\"id\": %s, \"seat\": \"%c\", \"layouts\": %d, \"tricks\": {", id.c_str(),
+            SeatLetter(single_dummy.SeatToPlay()), single_dummy.NumSamples());
+    for (const auto& card_score : card_scores)
+      fprintf(out, "%s\"%s\": %.2f", &card_score == &card_scores[0] ? "" : ", ",
+              NameOf(card_score.card), card_score.tricks);
+    fprintf(out, "}, \"done\": true, \"time\": %.3f}\n", Now() - start_time);
+  }
+}
+
+void Serve(FILE* in, FILE* out) {
+  char* line = nullptr;
+  size_t size = 0;
+  while (getline(&line, &size, in) > 0) {
+    if (strspn(line, " \t\r\n") == strlen(line)) continue;
+    Answer(line, out);
+    fflush(out);
+  }
+  free(line);
+}
+
+// Each worker takes connections off the listen queue, whose length bounds the
+// connections waiting for a worker, and answers them one at a time. Workers
+// keep their caches warm as in WarmCaches.
+void RunServer() {
+  if (strcmp(options.socket_path, "-") == 0) {
+    Serve(stdin, stdout);
+    return;
+  }
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (strlen(options.socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path is too long: '%s'.\n", options.socket_path);
+    exit(-1);
+  }
+  strcpy(address.sun_path, options.socket_path);
+  unlink(options.socket_path);
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(listener, 4 * options.num_workers) != 0) {
+    fprintf(stderr, "Can't listen on '%s'.\n", options.socket_path);
+    exit(-1);
+  }
+  // A client that goes away must not take the worker with it.
+  signal(SIGPIPE, SIG_IGN);
 
+  auto fork_worker = [listener] {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "Can't fork a worker.\n");
+      exit(-1);
+    }
+    if (pid > 0) return;
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    while (true) {
+      int connection = accept(listener, nullptr, nullptr);
+      if (connection < 0) continue;
+      FILE* in = fdopen(connection, "r");
+      FILE* out = fdopen(dup(connection), "w");
+      Serve(in, out);
+      fclose(in);
+      fclose(out);
+    }
+  };
+  for (int i = 0; i < options.num_workers; ++i) fork_worker();
+  // Replaces workers that exit, e.g. on an error that the request checks missed.
+  while (wait(nullptr) > 0) fork_worker();
+}
+
+void ShowDeal(const Hands& hands) {
   if (options.show_hands_mask & 1) hands.ShowCode();
   if (options.show_hands_mask & 2) hands.ShowCompact();
   if (options.show_hands_mask & 4) hands.ShowDetailed();
-  if (options.deal_only) return 0;
+  if (options.show_hands_mask & 8) CanonicalDeal(hands).canonical_hands().ShowCode();
+}
 
-  if (options.trump != -1) {
-    trumps.clear();
-    trumps.push_back(options.trump);
-  }
-  if (options.play_interactively) {
+// Returns false if the solving is cancelled.
+bool SolveDeal(const Hands& hands, const std::vector<int>& trumps,
+               const std::vector<int>& lead_seats) {
+  if (options.estimate_cost) {
+    printf("%.3f s\n", EstimateSolveTime(hands));
+  } else if (options.par) {
+    int dealer = CharToSeat(options.par[0]);
+    const char* vulnerability = options.par[1] == '/' ? options.par + 2 : "None";
+    bool vulnerable[ParSolver::NUM_SIDES] = {
+        !strcasecmp(vulnerability, "NS") || !strcasecmp(vulnerability, "All"),
+        !strcasecmp(vulnerability, "EW") || !strcasecmp(vulnerability, "All")};
+    if ((options.par[1] && options.par[1] != '/') ||
+        (!vulnerable[0] && !vulnerable[1] && strcasecmp(vulnerability, "None"))) {
+      fprintf(stderr, "Unknown dealer and vulnerability: %s\n", options.par);
+      exit(-1);
+    }
+    if (hands.num_tricks() != TOTAL_TRICKS) {
+      fprintf(stderr, "Par needs a full deal.\n");
+      exit(-1);
+    }
+    auto start_time = Now();
+    ParSolver par_solver(hands, dealer, vulnerable);
+    auto outcome = par_solver.Solve();
+    printf("Par NS %+d:", outcome.ns_score);
+    if (outcome.contracts.empty()) printf(" passed out");
+    for (const auto& contract : outcome.contracts) {
+      int needed = contract.level + 6;
+      printf("%s %d%s%s by %s %s %d", &contract == &outcome.contracts[0] ? "" : ",",
+             contract.level, SuitSign(contract.strain), contract.doubled ? "X" : "",
+             contract.side == ParSolver::NS ? "NS" : "EW",
+             contract.tricks >= needed ? "making" : "down",
+             contract.tricks >= needed ? contract.tricks : needed - contract.tricks);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("\n%d probes in %d of 20 cells %5.2f s %5.1f M\n", par_solver.num_probes(),
+           par_solver.num_cells_probed(), Now() - start_time, usage.ru_maxrss / 1024.0);
+  } else if (options.max_samples > 0) {
+    if (trumps.size() != 1 || lead_seats.size() != 1) {
+      fprintf(stderr, "Single-dummy play needs a trump and a lead seat.\n");
+      exit(-1);
+    }
+    auto plays = options.play_record ? ParsePlays(options.play_record) : std::vector<int>();
+    SingleDummy single_dummy(hands, trumps[0], lead_seats[0], plays);
+    if (!single_dummy.Legal()) {
+      fprintf(stderr, "The plays are not legal.\n");
+      exit(-1);
+    }
+    auto card_scores = single_dummy.Evaluate(options.max_samples, options.num_threads);
+    int seat = single_dummy.SeatToPlay();
+    printf("%s to play, tricks for %s over %d layouts:\n", SeatName(seat),
+           IsNs(seat) ? "NS" : "EW", single_dummy.NumSamples());
+    for (const auto& card_score : card_scores)
+      printf("%s %c %5.2f ±%.2f\n", SuitSign(SuitOf(card_score.card)), NameOf(card_score.card)[1],
+             card_score.tricks, card_score.error);
+  } else if (options.play_record) {
+    if (trumps.size() != 1 || lead_seats.size() != 1) {
+      fprintf(stderr, "Analyzing plays needs a trump and a lead seat.\n");
+      exit(-1);
+    }
+    std::vector<PlayAnalysis::Record> records;
+    PlayAnalysis analysis(hands, trumps[0], lead_seats[0]);
+    int ns_tricks = analysis.Analyze(ParsePlays(options.play_record), &records);
+    printf("%s by %s: NS %d\n", SuitName(trumps[0]), SeatName((lead_seats[0] + 3) % NUM_SEATS),
+           ns_tricks);
+    for (size_t i = 0; i < records.size(); ++i) {
+      const auto& record = records[i];
+      printf("%2zu %c %s %c NS %2d", i + 1, SeatLetter(record.seat),
+             SuitSign(SuitOf(record.card)), NameOf(record.card)[1], record.ns_tricks);
+      if (record.loss) printf("  loses %d", record.loss);
+      puts("");
+    }
+  } else if (options.play_interactively) {
     auto do_nothing = [](int trump) {};
-    auto seat_done = [&hands](int trump, int lead_seat, int ns_tricks) {
-      if (hands.num_tricks() < TOTAL_TRICKS ||
+    auto seat_done = [&hands](int trump, int lead_seat, Bounds ns_bounds) {
+      int ns_tricks = ns_bounds.lower;
+      if (ns_bounds.lower != ns_bounds.upper) {
+        printf("%s by %s is unsolved: NS %d-%d.\n", SuitSign(trump),
+               SeatName((lead_seat + 3) % NUM_SEATS), ns_bounds.lower, ns_bounds.upper);
+      } else if (hands.num_tricks() < TOTAL_TRICKS ||
           (hands.num_tricks() == TOTAL_TRICKS && ns_tricks >= 7 && !IsNs(lead_seat)) ||
           (hands.num_tricks() == TOTAL_TRICKS && ns_tricks < 7 && IsNs(lead_seat))) {
         InteractivePlay(hands, trump, lead_seat, ns_tricks);
@@ -2437,8 +4677,15 @@ int main(int argc, char* argv[]) {
   } else {
     auto start_time = Now();
     auto trump_start = [](int trump) { printf("%c", SuitName(trump)[0]); };
-    auto seat_done = [&hands](int trump, int lead_seat, int ns_tricks) {
-      printf(" %2d", IsNs(lead_seat) ? hands.num_tricks() - ns_tricks : ns_tricks);
+    auto seat_done = [&hands](int trump, int lead_seat, Bounds ns_bounds) {
+      // Unsolved cells show the proven range of tricks.
+      int n = hands.num_tricks();
+      int lower = IsNs(lead_seat) ? n - ns_bounds.upper : ns_bounds.lower;
+      int upper = IsNs(lead_seat) ? n - ns_bounds.lower : ns_bounds.upper;
+      if (lower == upper)
+        printf(" %2d", lower);
+      else
+        printf(" %d-%d", lower, upper);
       fflush(stdout);
     };
     auto trump_done = [start_time](int trump) {
@@ -2447,8 +4694,85 @@ int main(int argc, char* argv[]) {
       printf(" %5.2f s %5.1f M\n", Now() - start_time, usage.ru_maxrss / 1024.0);
       fflush(stdout);
     };
-    Solve(hands, trumps, lead_seats, trump_start, seat_done, trump_done);
+    // The first interrupt cancels the search, which still shows the proven bounds.
+    static SolveMonitor monitor;
+    auto cancel = [](int signal_number) {
+      monitor.cancelled = true;
+      signal(signal_number, SIG_DFL);
+    };
+    signal(SIGINT, cancel);
+    signal(SIGTERM, cancel);
+    if (options.progress_nodes > 0) {
+      monitor.progress_nodes = options.progress_nodes;
+      monitor.progress = [](const SearchProgress& progress) {
+        fprintf(stderr, "%c %c nodes %lld iteration %d NS %d-%d\n", SuitName(progress.trump)[0],
+                SeatLetter(progress.lead_seat), progress.nodes, progress.iteration,
+                progress.ns_bounds.lower, progress.ns_bounds.upper);
+      };
+    }
+    Solve(hands, trumps, lead_seats, trump_start, seat_done, trump_done, &monitor);
+    return !monitor.cancelled;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  options.Read(argc, argv);
+  if (options.socket_path) {
+    if (options.results_file) results_store.Open(options.results_file);
+    if (options.endgame_file) {
+      if (access(options.endgame_file, F_OK) != 0) BuildEndgameTable(options.endgame_file);
+      endgame_table.Load(options.endgame_file);
+    }
+    RunServer();
+    return 0;
+  }
+
+  Hands hands;
+  std::vector<int> trumps = {NOTRUMP, SPADE, HEART, DIAMOND, CLUB};
+  std::vector<int> lead_seats = {WEST, EAST, NORTH, SOUTH};
+  if (options.code) {
+    if (!hands.Decode(options.code)) {
+      fprintf(stderr, "Invalid code: '%s'.\n", options.code);
+      exit(-1);
+    }
+  } else if (options.input_file) {
+    ReadHands(hands, trumps, lead_seats);
+  } else if (options.randomize) {
+    if (options.num_deals == 0) hands.Randomize();
+  } else {
+    options.ShowUsage(argv[0]);
+  }
+  if (options.shuffle_seats) hands.Shuffle(options.shuffle_seats);
+
+  if (!options.deal_only) {
+    if (options.results_file) results_store.Open(options.results_file);
+    if (options.endgame_file) {
+      if (access(options.endgame_file, F_OK) != 0) BuildEndgameTable(options.endgame_file);
+      endgame_table.Load(options.endgame_file);
+    }
+  }
+  if (options.trump != -1) {
+    trumps.clear();
+    trumps.push_back(options.trump);
+  }
+
+  if (options.num_deals > 0) {
+    auto start_time = Now();
+    DealGenerator generator(hands, options.constraints);
+    int num_deals = 0;
+    while (num_deals < options.num_deals) {
+      auto deal = generator.Next();
+      ++num_deals;
+      ShowDeal(deal);
+      if (!options.deal_only && !SolveDeal(deal, trumps, lead_seats)) break;
+    }
+    fprintf(stderr, "%d deals from %lld tries in %.2f s\n", num_deals, generator.tries(),
+            Now() - start_time);
+    return 0;
   }
+  ShowDeal(hands);
+  if (!options.deal_only) SolveDeal(hands, trumps, lead_seats);
   return 0;
 }
 #endif  // _WEB
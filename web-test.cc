@@ -145,9 +145,110 @@ void TestDifferentContracts() {
   assert(plays == "SA:+0 ST:+0 S8:+0 S2:+0 HA:+0 H9:+1 H6:+1 DQ:+1 D8:+1 C9:+0 ");
 }
 
+void TestAnalyzePlays() {
+  std::string west("♠ 43 ♥ 82 ♦ AQT874 ♣ AQ6");
+  std::string north("♠ AQ95 ♥ K754 ♦ J ♣ JT54");
+  std::string east("♠ KJ2 ♥ JT ♦ 9652 ♣ K732");
+  std::string south("♠ T876 ♥ AQ963 ♦ K3 ♣ 98");
+
+  // 3H by North. Leading the diamond queen gives away a trick.
+  auto analysis = analyze_plays(west, north, east, south, HEART, WEST, "pc|DQ|pc|DJ|");
+  printf("Analysis: %s\n", analysis.c_str());
+  assert(analysis.substr(0, 8) == "8 DQ:9:1");
+
+  // Results must agree with solving each position from scratch.
+  std::string played("S4SAS2S8DJD2DKDAS3S5SJS7SKS6D4S9HJH6H8HKH7HTHAH2STD8SQC3"
+                     "H5D6HQD7D3DQH4D9C5CKC9C6C7C8CACJCQCTC2H9H3DTC4D5");
+  analysis = analyze_plays(west, north, east, south, HEART, WEST, played);
+  printf("Analysis: %s\n", analysis.c_str());
+  std::regex card_re(" (..):([0-9]+):([0-9]+)");
+  int num_cards = 0;
+  for (std::sregex_iterator it(analysis.begin(), analysis.end(), card_re), end; it != end;
+       ++it, ++num_cards) {
+    auto plays = solve_plays(west, north, east, south, 3, HEART, WEST,
+                             played.substr(0, num_cards * 2));
+    auto card = (*it)[1].str();
+    auto pos = plays.find(card + ":");
+    assert(pos != std::string::npos);
+    int ns_tricks = 9 + std::stoi(plays.substr(pos + 3));
+    assert(ns_tricks == std::stoi((*it)[2].str()));
+  }
+  assert(num_cards == 52);
+}
+
+void TestParScores() {
+  typedef ParSolver::Contract Contract;
+  assert(ParSolver::Score(Contract{3, NOTRUMP, ParSolver::NS, 9, false}, false) == 400);
+  assert(ParSolver::Score(Contract{3, NOTRUMP, ParSolver::NS, 9, false}, true) == 600);
+  assert(ParSolver::Score(Contract{2, CLUB, ParSolver::NS, 9, false}, false) == 110);
+  assert(ParSolver::Score(Contract{5, DIAMOND, ParSolver::NS, 11, false}, false) == 400);
+  assert(ParSolver::Score(Contract{6, SPADE, ParSolver::NS, 12, false}, true) == 1430);
+  assert(ParSolver::Score(Contract{7, NOTRUMP, ParSolver::NS, 13, false}, false) == 1520);
+  assert(ParSolver::Score(Contract{4, SPADE, ParSolver::NS, 9, true}, false) == -100);
+  assert(ParSolver::Score(Contract{4, SPADE, ParSolver::NS, 8, true}, true) == -500);
+  assert(ParSolver::Score(Contract{4, SPADE, ParSolver::NS, 6, true}, false) == -800);
+  assert(ParSolver::Score(Contract{4, SPADE, ParSolver::NS, 6, true}, true) == -1100);
+
+  // NS make 3NT, while EW take 8 tricks in hearts.
+  auto hands = CollectHands("J8643 J9 K83 A75", "A2 T62 AQ976 K96",
+                            "Q KQ7543 T2 Q432", "KT975 A8 J54 JT8");
+  // Not vulnerable, EW would rather go two down in 4H doubled.
+  bool none[] = {false, false};
+  auto par = ParSolver(hands, NORTH, none).Solve();
+  printf("Par: %+d\n", par.ns_score);
+  assert(par.ns_score == 300);
+  assert(par.contracts.size() == 1);
+  const auto& sacrifice = par.contracts[0];
+  assert(sacrifice.level == 4 && sacrifice.strain == HEART && sacrifice.side == ParSolver::EW);
+  assert(sacrifice.tricks == 8 && sacrifice.doubled);
+
+  // Vulnerable, the sacrifice costs more than the game.
+  bool ew[] = {false, true};
+  par = ParSolver(hands, NORTH, ew).Solve();
+  printf("Par: %+d\n", par.ns_score);
+  assert(par.ns_score == 400);
+  assert(par.contracts.size() == 1);
+  const auto& game = par.contracts[0];
+  assert(game.level == 3 && game.strain == NOTRUMP && game.side == ParSolver::NS);
+  assert(game.tricks == 9 && !game.doubled);
+}
+
+// Runs with -d may miss tricks, so they must leave the results store alone.
+void TestDiscardsSkipResultsStore() {
+  std::string west("♠ 7 ♥ QJ7542 ♦ JT974 ♣ A");
+  std::string north("♠ T9852 ♥ KT83 ♦ 862 ♣ 6");
+  std::string east("♠ AKJ4 ♥ 9 ♦ AK5 ♣ Q7542");
+  std::string south("♠ Q63 ♥ A6 ♦ Q3 ♣ KJT983");
+
+  char file_name[] = "/tmp/results-store-XXXXXX";
+  close(mkstemp(file_name));
+  results_store.Open(file_name);
+  auto file_size = [&file_name]() {
+    FILE* file = fopen(file_name, "r");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+  };
+
+  options.discard_suit_bottom = true;
+  solve(west, north, east, south);
+  options.discard_suit_bottom = false;
+  printf("Store after -d: %ld bytes\n", file_size());
+  assert(file_size() == 0);
+
+  solve(west, north, east, south);
+  printf("Store after exact solve: %ld bytes\n", file_size());
+  assert(file_size() > 0);
+  remove(file_name);
+}
+
 int main(int argc, char *argv[]) {
   Test1();
   Test2();
   TestDifferentContracts();
+  TestAnalyzePlays();
+  TestParScores();
+  TestDiscardsSkipResultsStore();
   return 0;
 }